@@ -1,8 +1,10 @@
 TEMPLATE = app
-CONFIG += console c++1z
+CONFIG += console c++1z thread
 CONFIG -= app_bundle
 CONFIG -= qt
 
+unix:LIBS += -pthread
+
 SOURCES += main.cpp \
     hash_utils.cpp
 
@@ -11,4 +13,15 @@ HEADERS += \
     array_list.hpp \
     singly_linked_list.hpp \
     point.hpp \
-    hash_utils.hpp
+    hash_utils.hpp \
+    table_stats.hpp \
+    swiss_hashtable.hpp \
+    concurrent_hashtable.hpp \
+    readmostly_hashtable.hpp \
+    sharded_map.hpp \
+    oa_snapshot.hpp \
+    occupancy_bitmap.hpp \
+    any_map.hpp \
+    cuckoo_hashtable.hpp \
+    hopscotch_hashtable.hpp \
+    soa_hashtable.hpp
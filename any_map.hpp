@@ -0,0 +1,103 @@
+#ifndef ANY_MAP_HPP
+#define ANY_MAP_HPP
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include "hashtable.hpp"
+
+//Owning handle to an engine picked at run time, for code that cannot be
+//templated on the table type. Each call costs one indirect call, code that
+//knows the engine should take it by its own type instead (see IsMapLike).
+//Engines deriving from Map<K,V> are held as they are, other map-like types
+//behind an adapter. A moved-from AnyMap must not be used.
+template<class K, class V>
+class AnyMap
+{
+public:
+    template<class Table, class = std::enable_if_t<
+                 !std::is_same<std::decay_t<Table>, AnyMap<K,V>>::value>>
+    AnyMap(Table &&table);
+    //Builds the engine in place, for the ones that cannot be moved
+    template<class Table, class... Args>
+    explicit AnyMap(std::in_place_type_t<Table>, Args&&... args);
+    AnyMap(AnyMap<K,V> &&other) = default;
+    AnyMap<K,V>& operator=(AnyMap<K,V> &&rhs) = default;
+    inline size_t count() const noexcept { return mMap->count(); }
+    inline bool isEmpty() const noexcept { return mMap->isEmpty(); }
+    inline void insert(const K &key, const V &value) { mMap->insert(key, value); }
+    inline void insert(K &&key, V &&value) { mMap->insert(std::move(key), std::move(value)); }
+    inline void update(const K &key, const V &value) { mMap->update(key, value); }
+    inline void remove(const K &key) { mMap->remove(key); }
+    inline bool find(const K &key, V &value) const { return mMap->find(key, value); }
+    inline const V get(const K &key) const { return mMap->get(key); }
+    //The engine when it is a Table, nullptr otherwise
+    template<class Table>
+    Table* target() noexcept;
+    template<class Table>
+    const Table* target() const noexcept;
+private:
+    template<class Table>
+    class Adapter;
+    template<class Table>
+    static constexpr bool IS_MAP {std::is_base_of<Map<K,V>, Table>::value};
+    template<class Table>
+    using Holder = std::conditional_t<IS_MAP<Table>, Table, Adapter<Table>>;
+
+    std::unique_ptr<Map<K,V>> mMap;
+};
+
+template<class K, class V>
+template<class Table>
+class AnyMap<K,V>::Adapter final: public Map<K,V>
+{
+public:
+    template<class... Args>
+    explicit Adapter(Args&&... args): table(std::forward<Args>(args)...) {}
+    virtual size_t count() const noexcept override { return table.count(); }
+    virtual void insert(const K &key, const V &value) override { table.insert(key, value); }
+    virtual void insert(K &&key, V &&value) override { table.insert(std::move(key), std::move(value)); }
+    virtual void update(const K &key, const V &value) override { table.update(key, value); }
+    virtual void remove(const K &key) override { table.remove(key); }
+    virtual bool find(const K &key, V &value) const override { return table.find(key, value); }
+    virtual const V get(const K &key) const override { return table.get(key); }
+
+    Table table;
+};
+
+template<class K, class V>
+template<class Table, class>
+AnyMap<K,V>::AnyMap(Table &&table):
+    AnyMap(std::in_place_type_t<std::decay_t<Table>>(), std::forward<Table>(table))
+{}
+
+template<class K, class V>
+template<class Table, class... Args>
+AnyMap<K,V>::AnyMap(std::in_place_type_t<Table>, Args&&... args):
+    mMap(new Holder<Table>(std::forward<Args>(args)...))
+{
+    static_assert(IsMapLike<Table>::value, "AnyMap needs a map-like table");
+    static_assert(std::is_same<typename Table::key_type, K>::value &&
+                  std::is_same<typename Table::mapped_type, V>::value,
+                  "The key and value types of the table must be K and V");
+}
+
+template<class K, class V>
+template<class Table>
+Table* AnyMap<K,V>::target() noexcept
+{
+    auto holder = dynamic_cast<Holder<Table>*>(mMap.get());
+    if constexpr(IS_MAP<Table>)
+        return holder;
+    else
+        return holder ? &holder->table : nullptr;
+}
+
+template<class K, class V>
+template<class Table>
+const Table* AnyMap<K,V>::target() const noexcept
+{
+    return const_cast<AnyMap<K,V>*>(this)->template target<Table>();
+}
+
+#endif // ANY_MAP_HPP
@@ -2,60 +2,115 @@
 #define ARRAY_LIST_HPP
 
 #include <cstdlib>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
 
+//Dynamic array on uninitialized storage: only the first mSize slots hold
+//constructed elements, the rest of the capacity is raw memory. Growth moves
+//the elements (or copies the bytes of trivially copyable ones) instead of
+//default-constructing the new storage and copy-assigning into it.
 template<class T>
 class Array
 {
 public:
     explicit Array(size_t capacity = 31u);
+    //Holds count copies of value, size and capacity are both count
+    Array(size_t count, const T &value);
     Array(const Array<T> &other);
-    Array(Array<T> &&other);
+    Array(Array<T> &&other) noexcept;
     Array<T>& operator=(const Array<T> &other);
-    Array<T>& operator=(Array<T> &&other);
+    Array<T>& operator=(Array<T> &&other) noexcept;
     ~Array();
     inline size_t size() const noexcept { return mSize; }
     inline size_t capacity() const noexcept { return mCapacity; }
     inline float loadFactor() const noexcept { return static_cast<float>(mSize) / mCapacity; }
     inline bool isEmpty() const noexcept { return mSize == 0; }
     void add(const T &item);
+    void add(T &&item);
+    template<class... Args>
+    T& emplace_back(Args&&... args);
     void removeAt(size_t index);
+    void clear() noexcept;
     int search(const T& elementToSearch) const noexcept;
     T fetchMax() const noexcept;
     T fetchMin() const noexcept;
     T& getElementAt(size_t index);
+    //Sets the capacity, elements that do not fit are destroyed
     void resize(size_t newCapacity);
+    //Grows the capacity to at least newCapacity, never shrinks
+    void reserve(size_t newCapacity);
+    void shrink_to_fit();
     T& operator[](size_t index);
     const T& operator[](size_t index) const;
     operator T* (void) const;
 private:
     size_t mSize, mCapacity;
     T *mData;
+    static T* allocate(size_t capacity);
+    static void deallocate(T *data) noexcept;
+    void destroyFrom(size_t index) noexcept;
+    void relocate(size_t newCapacity);
     void ensureCapacity();
 };
 
 template<class T>
 Array<T>::Array(size_t capacity):
-    mSize{0u}, mCapacity{capacity}
+    mSize{0u}, mCapacity{capacity}, mData{allocate(capacity)}
 {
-    mData = new T[capacity];
 }
 
 template<class T>
-Array<T>::Array(const Array<T> &other):
-    mSize{other.mSize},
-    mCapacity{other.mCapacity}
+Array<T>::Array(size_t count, const T &value):
+    mSize{0u}, mCapacity{count}, mData{allocate(count)}
+{
+    try
+    {
+        for(; mSize < count; ++mSize)
+            new (mData + mSize) T(value);
+    }
+    catch(...)
+    {
+        destroyFrom(0u);
+        deallocate(mData);
+        throw;
+    }
+}
 
+template<class T>
+Array<T>::Array(const Array<T> &other):
+    mSize{0u},
+    mCapacity{other.mCapacity},
+    mData{allocate(other.mCapacity)}
 {
-    mData = new T[mSize];
-    for(size_t i{0u}; i < mSize; ++i)
-        mData[i] = other.mData[i];
+    if constexpr(std::is_trivially_copyable_v<T>)
+    {
+        if(other.mSize)
+            std::memcpy(static_cast<void*>(mData), other.mData, other.mSize * sizeof(T));
+        mSize = other.mSize;
+    }
+    else
+    {
+        try
+        {
+            for(; mSize < other.mSize; ++mSize)
+                new (mData + mSize) T(other.mData[mSize]);
+        }
+        catch(...)
+        {
+            destroyFrom(0u);
+            deallocate(mData);
+            throw;
+        }
+    }
 }
 
 template<class T>
-Array<T>::Array(Array<T> &&other):
+Array<T>::Array(Array<T> &&other) noexcept:
     mSize{other.mSize},
     mCapacity{other.mCapacity},
-    mData{std::move(other).mData}
+    mData{other.mData}
 {
     other.mSize = 0;
     other.mCapacity = 0;
@@ -66,22 +121,19 @@ template<class T>
 Array<T>& Array<T>::operator=(const Array<T> &other)
 {
     if(this == &other) return *this;
-    mSize = other.mSize;
-    mCapacity = other.mCapacity;
-    delete [] mData;
-    mData = new T[mSize];
-    for(size_t i{0u}; i < mSize; ++i)
-        mData[i] = other.mData[i];
-    return *this;
+    Array<T> copy(other);
+    return *this = std::move(copy);
 }
 
 template<class T>
-Array<T>& Array<T>::operator=(Array<T> &&other)
+Array<T>& Array<T>::operator=(Array<T> &&other) noexcept
 {
+    if(this == &other) return *this;
+    destroyFrom(0u);
+    deallocate(mData);
     mSize = other.mSize;
     mCapacity = other.mCapacity;
-    delete [] mData;
-    mData = std::move(other).mData;
+    mData = other.mData;
     other.mSize = 0;
     other.mCapacity = 0;
     other.mData = nullptr;
@@ -91,7 +143,8 @@ Array<T>& Array<T>::operator=(Array<T> &&other)
 template<class T>
 Array<T>::~Array()
 {
-    delete [] mData;
+    destroyFrom(0u);
+    deallocate(mData);
 }
 
 template<class T>
@@ -125,10 +178,29 @@ T Array<T>::fetchMin() const noexcept
 
 template<class T>
 void Array<T>::add(const T &item)
+{
+    emplace_back(item);
+}
+
+template<class T>
+void Array<T>::add(T &&item)
+{
+    emplace_back(std::move(item));
+}
+
+template<class T>
+template<class... Args>
+T& Array<T>::emplace_back(Args&&... args)
 {
     if(mSize >= mCapacity)
+    {
+        //args may refer to an element of this array, build the item before
+        //the storage goes away
+        T item(std::forward<Args>(args)...);
         ensureCapacity();
-    mData[mSize++] = item;
+        return *new (mData + mSize++) T(std::move(item));
+    }
+    return *new (mData + mSize++) T(std::forward<Args>(args)...);
 }
 
 template<class T>
@@ -136,26 +208,37 @@ void Array<T>::removeAt(size_t index)
 {
     if(index >= this->mSize) return;
     for(size_t i = index; i < mSize - 1; ++i)
-        mData[i] = mData[i + 1];
-    --mSize;
+        mData[i] = std::move(mData[i + 1]);
+    destroyFrom(mSize - 1);
+}
+
+template<class T>
+void Array<T>::clear() noexcept
+{
+    destroyFrom(0u);
 }
 
 template<class T>
 void Array<T>::resize(size_t newCapacity)
 {
     if(newCapacity == mCapacity) return;
+    if(mSize > newCapacity)
+        destroyFrom(newCapacity);
+    relocate(newCapacity);
+}
 
-    T* newData = new T[newCapacity];
-
-    auto numOfElementsToSave = mSize < newCapacity ? mSize : newCapacity;
+template<class T>
+void Array<T>::reserve(size_t newCapacity)
+{
+    if(newCapacity > mCapacity)
+        relocate(newCapacity);
+}
 
-    size_t i = 0u;
-    for(; i < numOfElementsToSave ; ++i)
-        newData[i] = mData[i];
-    mSize = i;
-    mCapacity = newCapacity;
-    delete [] mData;
-    mData = newData;
+template<class T>
+void Array<T>::shrink_to_fit()
+{
+    if(mSize < mCapacity)
+        relocate(mSize);
 }
 
 template<class T>
@@ -183,15 +266,73 @@ Array<T>::operator T* (void) const
 }
 
 template<class T>
-void Array<T>::ensureCapacity()
+T* Array<T>::allocate(size_t capacity)
+{
+    if(capacity == 0) return nullptr;
+    if constexpr(alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+        return static_cast<T*>(::operator new(capacity * sizeof(T), std::align_val_t{alignof(T)}));
+    else
+        return static_cast<T*>(::operator new(capacity * sizeof(T)));
+}
+
+template<class T>
+void Array<T>::deallocate(T *data) noexcept
+{
+    if constexpr(alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+        ::operator delete(data, std::align_val_t{alignof(T)});
+    else
+        ::operator delete(data);
+}
+
+//Destroys the elements from index to the end, which becomes the new size
+template<class T>
+void Array<T>::destroyFrom(size_t index) noexcept
+{
+    if constexpr(!std::is_trivially_destructible_v<T>)
+    {
+        for(size_t i{index}; i < mSize; ++i)
+            mData[i].~T();
+    }
+    mSize = index < mSize ? index : mSize;
+}
+
+//Moves the elements into new storage of newCapacity, which must hold them all
+template<class T>
+void Array<T>::relocate(size_t newCapacity)
 {
-    T* newData = new T[2 * mCapacity];
-    for(size_t i {0u}; i < mSize; ++i)
-        newData[i] = mData[i];
-    mCapacity *= 2;
-    delete [] mData;
+    T *newData = allocate(newCapacity);
+    if constexpr(std::is_trivially_copyable_v<T>)
+    {
+        if(mSize)
+            std::memcpy(static_cast<void*>(newData), mData, mSize * sizeof(T));
+    }
+    else
+    {
+        size_t i{0u};
+        try
+        {
+            for(; i < mSize; ++i)
+                new (newData + i) T(std::move_if_noexcept(mData[i]));
+        }
+        catch(...)
+        {
+            while(i > 0)
+                newData[--i].~T();
+            deallocate(newData);
+            throw;
+        }
+        for(i = 0u; i < mSize; ++i)
+            mData[i].~T();
+    }
+    deallocate(mData);
     mData = newData;
-    std::cout << "Array capacity was increased to " << mCapacity << std::endl;
+    mCapacity = newCapacity;
+}
+
+template<class T>
+void Array<T>::ensureCapacity()
+{
+    relocate(mCapacity ? 2 * mCapacity : 1u);
 }
 
 #endif // ARRAY_LIST_HPP
@@ -0,0 +1,727 @@
+//Benchmark of the table engines against std::unordered_map.
+//
+//The *_seeded tables use SeededHasher, and SeededStepHasher for the open
+//addressing step, to weigh the cost of flood resistance against the default
+//hashers.
+//
+//Every scenario (engine x key distribution x size x load factor) runs the
+//phases insert, hit lookup, miss lookup, iteration, churn and erase on a
+//fresh table. A scenario is run twice: the first run times whole phases for
+//the throughput, the second one times single operations (every op up to
+//LATENCY_SAMPLES per phase, evenly spread above) for the p50/p99/p999
+//latencies, so the clock reads never weigh on the throughput figures.
+//
+//Usage: bench [--sizes=1000,100000] [--load-factors=0.5,0.7]
+//             [--distributions=seq,uniform,zipf,short_str,long_str]
+//             [--tables=chained,oa_linear,oa_quadratic,oa_double,oa_robin_hood,swiss,cuckoo,
+//                       hopscotch,soa_linear,soa_quadratic,soa_double,soa_robin_hood,std,
+//                       chained_seeded,oa_linear_seeded,swiss_seeded]
+//             [--format=csv|json] [--seed=N]
+//
+//--mode=quality compares the string hash functions of hash_utils instead:
+//bucket chi-square of the low and of the high hash bits, avalanche bias and
+//speed, on the short_str and long_str keys of the first size and on the keys
+//of --keys-file (one key per line) when given.
+//Results go to stdout, progress to stderr.
+
+#include "hashtable.hpp"
+#include "swiss_hashtable.hpp"
+#include "cuckoo_hashtable.hpp"
+#include "hopscotch_hashtable.hpp"
+#include "soa_hashtable.hpp"
+#include "hash_utils.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t LATENCY_SAMPLES {100000u};
+constexpr double ZIPF_EXPONENT {0.99};
+
+struct Options
+{
+    std::vector<size_t> sizes {1000u, 10000u, 100000u, 1000000u};
+    std::vector<double> loadFactors {0.5, 0.7, 0.9};
+    std::vector<std::string> distributions {"seq", "uniform", "zipf", "short_str", "long_str"};
+    std::vector<std::string> tables {"chained", "oa_linear", "oa_quadratic", "oa_double",
+                                     "oa_robin_hood", "swiss", "cuckoo", "hopscotch", "soa_linear",
+                                     "soa_quadratic", "soa_double", "soa_robin_hood", "std",
+                                     "chained_seeded",
+                                     "oa_linear_seeded", "swiss_seeded"};
+    std::string format {"csv"};
+    uint64_t seed {42u};
+    std::string mode {"tables"};
+    std::string keysFile;
+};
+
+struct Result
+{
+    std::string table;
+    std::string distribution;
+    size_t size;
+    double loadFactor;
+    std::string operation;
+    size_t ops;
+    double seconds;
+    double p50, p99, p999;      //Nanoseconds
+};
+
+//Uniform engine interface over the tables, so the phases are written once
+template<class Table, class K>
+struct Engine;
+
+template<class K, class Hasher, class KeyEqual>
+struct Engine<HashTable<K,uint64_t,Hasher,KeyEqual>, K>
+{
+    HashTable<K,uint64_t,Hasher,KeyEqual> table;
+    Engine(size_t, double loadFactor): table(16u) { table.setMaxLoadFactor(float(loadFactor)); }
+    void insert(const K &key, uint64_t value) { table.insert(key, value); }
+    bool find(const K &key, uint64_t &value) const { return table.find(key, value); }
+    void remove(const K &key) { table.remove(key); }
+    static constexpr bool CAN_ITERATE {true};
+    uint64_t iterate()
+    {
+        uint64_t sum {0u};
+        for(const auto &item : table)
+            sum += item.value;
+        return sum;
+    }
+};
+
+template<class K, class Hasher, class Hasher2, class KeyEqual>
+struct Engine<OpenAddressingHashTable<K,uint64_t,Hasher,Hasher2,KeyEqual>, K>
+{
+    OpenAddressingHashTable<K,uint64_t,Hasher,Hasher2,KeyEqual> table;
+    Engine(size_t, double loadFactor, CollisionResolutionMethod method): table(8u, method)
+    {
+        table.setMaxFillFactor(loadFactor);
+    }
+    void insert(const K &key, uint64_t value) { table.insert(key, value); }
+    bool find(const K &key, uint64_t &value) const { return table.find(key, value); }
+    void remove(const K &key) { table.remove(key); }
+    static constexpr bool CAN_ITERATE {true};
+    uint64_t iterate()
+    {
+        uint64_t sum {0u};
+        for(const auto &item : table)
+            sum += item.value;
+        return sum;
+    }
+};
+
+template<class K, class Hasher, class Hasher2, class KeyEqual>
+struct Engine<SoaOpenAddressingHashTable<K,uint64_t,Hasher,Hasher2,KeyEqual>, K>
+{
+    SoaOpenAddressingHashTable<K,uint64_t,Hasher,Hasher2,KeyEqual> table;
+    Engine(size_t, double loadFactor, CollisionResolutionMethod method): table(8u, method)
+    {
+        table.setMaxFillFactor(loadFactor);
+    }
+    void insert(const K &key, uint64_t value) { table.insert(key, value); }
+    bool find(const K &key, uint64_t &value) const { return table.find(key, value); }
+    void remove(const K &key) { table.remove(key); }
+    static constexpr bool CAN_ITERATE {false};
+    uint64_t iterate() { return 0u; }
+};
+
+template<class K, class Hasher, class KeyEqual>
+struct Engine<SwissHashTable<K,uint64_t,Hasher,KeyEqual>, K>
+{
+    SwissHashTable<K,uint64_t,Hasher,KeyEqual> table;
+    Engine(size_t, double): table(16u) {}
+    void insert(const K &key, uint64_t value) { table.insert(key, value); }
+    bool find(const K &key, uint64_t &value) const { return table.find(key, value); }
+    void remove(const K &key) { table.remove(key); }
+    static constexpr bool CAN_ITERATE {false};
+    uint64_t iterate() { return 0u; }
+};
+
+template<class K, class Hasher, class Hasher2, class KeyEqual>
+struct Engine<CuckooHashTable<K,uint64_t,Hasher,Hasher2,KeyEqual>, K>
+{
+    CuckooHashTable<K,uint64_t,Hasher,Hasher2,KeyEqual> table;
+    Engine(size_t, double loadFactor) { table.setMaxLoadFactor(loadFactor); }
+    void insert(const K &key, uint64_t value) { table.insert(key, value); }
+    bool find(const K &key, uint64_t &value) const { return table.find(key, value); }
+    void remove(const K &key) { table.remove(key); }
+    static constexpr bool CAN_ITERATE {false};
+    uint64_t iterate() { return 0u; }
+};
+
+template<class K, class Hasher, class KeyEqual>
+struct Engine<HopscotchHashTable<K,uint64_t,Hasher,KeyEqual>, K>
+{
+    HopscotchHashTable<K,uint64_t,Hasher,KeyEqual> table;
+    Engine(size_t, double loadFactor) { table.setMaxLoadFactor(loadFactor); }
+    void insert(const K &key, uint64_t value) { table.insert(key, value); }
+    bool find(const K &key, uint64_t &value) const { return table.find(key, value); }
+    void remove(const K &key) { table.remove(key); }
+    static constexpr bool CAN_ITERATE {false};
+    uint64_t iterate() { return 0u; }
+};
+
+template<class K>
+struct Engine<std::unordered_map<K,uint64_t>, K>
+{
+    std::unordered_map<K,uint64_t> table;
+    Engine(size_t, double loadFactor) { table.max_load_factor(float(loadFactor)); }
+    void insert(const K &key, uint64_t value) { table[key] = value; }
+    bool find(const K &key, uint64_t &value) const
+    {
+        auto it = table.find(key);
+        if(it == table.end()) return false;
+        value = it->second;
+        return true;
+    }
+    void remove(const K &key) { table.erase(key); }
+    static constexpr bool CAN_ITERATE {true};
+    uint64_t iterate()
+    {
+        uint64_t sum {0u};
+        for(const auto &item : table)
+            sum += item.second;
+        return sum;
+    }
+};
+
+//Keys 0..size-1 go into the table, size..2*size-1 are the misses.
+//Every generator is a bijection of the index, so the keys are distinct
+struct KeySet
+{
+    std::vector<uint64_t> ints;
+    std::vector<std::string> strings;
+    std::vector<size_t> lookupOrder;    //Indices of the hit lookups
+    std::vector<size_t> eraseOrder;     //Permutation of [0, size), each live key erased once
+};
+
+std::string makeString(uint64_t index, size_t length, std::mt19937_64 &rng)
+{
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    auto suffix = std::to_string(index);
+    std::string key(length > suffix.size() ? length - suffix.size() : 0u, 'a');
+    for(auto &c : key)
+        c = alphabet[rng() % (sizeof(alphabet) - 1)];
+    return key + suffix;
+}
+
+//Zipf ranks by inversion of the continuous approximation of the CDF,
+//rank 1 being the hottest. Ranks are mapped through a permutation so the
+//hot keys are not the first inserted ones
+std::vector<size_t> makeZipfOrder(size_t size, std::mt19937_64 &rng)
+{
+    std::vector<size_t> permutation(size);
+    for(size_t i{0u}; i < size; ++i)
+        permutation[i] = i;
+    std::shuffle(permutation.begin(), permutation.end(), rng);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    auto exponent = 1.0 - ZIPF_EXPONENT;
+    auto top = std::pow(double(size), exponent) - 1.0;
+    std::vector<size_t> order(size);
+    for(auto &index : order)
+    {
+        auto rank = size_t(std::pow(top * uniform(rng) + 1.0, 1.0 / exponent));
+        index = permutation[std::min(std::max<size_t>(rank, 1u), size) - 1];
+    }
+    return order;
+}
+
+KeySet makeKeys(const std::string &distribution, size_t size, uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    KeySet keys;
+    if(distribution == "short_str" || distribution == "long_str")
+    {
+        bool isShort = distribution == "short_str";
+        keys.strings.reserve(2 * size);
+        for(size_t i{0u}; i < 2 * size; ++i)
+        {
+            auto length = isShort ? 8u + rng() % 9u : 64u + rng() % 65u;
+            keys.strings.push_back(makeString(i, length, rng));
+        }
+    }
+    else
+    {
+        keys.ints.resize(2 * size);
+        for(size_t i{0u}; i < 2 * size; ++i)
+            keys.ints[i] = distribution == "seq" ? i : mix64(i ^ seed);
+    }
+    if(distribution == "zipf")
+    {
+        keys.lookupOrder = makeZipfOrder(size, rng);
+    }
+    else
+    {
+        keys.lookupOrder.resize(size);
+        for(size_t i{0u}; i < size; ++i)
+            keys.lookupOrder[i] = i;
+        std::shuffle(keys.lookupOrder.begin(), keys.lookupOrder.end(), rng);
+    }
+    //Zipf is for the hit lookups only, its repeats would make most erases misses
+    keys.eraseOrder.resize(size);
+    for(size_t i{0u}; i < size; ++i)
+        keys.eraseOrder[i] = i;
+    std::shuffle(keys.eraseOrder.begin(), keys.eraseOrder.end(), rng);
+    return keys;
+}
+
+//Times a phase as a whole, or single operations when measuring latency
+class Recorder
+{
+public:
+    Recorder(bool isLatencyRun, size_t ops):
+        mIsLatencyRun{isLatencyRun}, mStride{std::max<size_t>(1u, ops / LATENCY_SAMPLES)}
+    {}
+    template<class F>
+    void run(size_t ops, F &&op)
+    {
+        if(!mIsLatencyRun)
+        {
+            auto start = Clock::now();
+            for(size_t i{0u}; i < ops; ++i)
+                op(i);
+            mSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+            return;
+        }
+        for(size_t i{0u}; i < ops; ++i)
+        {
+            if(i % mStride)
+            {
+                op(i);
+                continue;
+            }
+            auto start = Clock::now();
+            op(i);
+            mSamples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+        }
+    }
+    inline double seconds() const noexcept { return mSeconds; }
+    double percentile(double fraction)
+    {
+        if(mSamples.empty()) return 0.0;
+        auto rank = std::min(mSamples.size() - 1, size_t(fraction * mSamples.size()));
+        std::nth_element(mSamples.begin(), mSamples.begin() + rank, mSamples.end());
+        return mSamples[rank];
+    }
+private:
+    bool mIsLatencyRun;
+    size_t mStride;
+    double mSeconds {0.0};
+    std::vector<double> mSamples;
+};
+
+//Keeps the results of lookups alive so the compiler cannot drop them
+volatile uint64_t gSink;
+
+template<class EngineType, class K>
+void runPhases(EngineType &engine, const std::vector<K> &keys, const KeySet &keySet,
+               size_t size, bool isLatencyRun, std::vector<Result> &phases)
+{
+    auto record = [&](const std::string &operation, size_t ops, auto &&op)
+    {
+        Recorder recorder(isLatencyRun, ops);
+        recorder.run(ops, op);
+        Result result {};
+        result.operation = operation;
+        result.ops = ops;
+        result.seconds = recorder.seconds();
+        result.p50 = recorder.percentile(0.5);
+        result.p99 = recorder.percentile(0.99);
+        result.p999 = recorder.percentile(0.999);
+        phases.push_back(result);
+    };
+    uint64_t sink {0u};
+    record("insert", size, [&](size_t i){ engine.insert(keys[i], i); });
+    record("hit_lookup", size, [&](size_t i){
+        uint64_t value {0u};
+        engine.find(keys[keySet.lookupOrder[i]], value);
+        sink += value;
+    });
+    record("miss_lookup", size, [&](size_t i){
+        uint64_t value {0u};
+        sink += engine.find(keys[size + i], value);
+    });
+    if(EngineType::CAN_ITERATE)
+    {
+        //One pass over the table, the throughput counts the visited items
+        record("iteration", 1u, [&](size_t){ sink += engine.iterate(); });
+        phases.back().ops = size;
+    }
+    //Churn swaps the live key set for the miss keys, one remove and one
+    //insert per operation
+    record("churn", size, [&](size_t i){
+        engine.remove(keys[i]);
+        engine.insert(keys[size + i], i);
+    });
+    record("erase", size, [&](size_t i){ engine.remove(keys[size + keySet.eraseOrder[i]]); });
+    gSink = sink;
+}
+
+template<class EngineType, class K, class... Args>
+void benchEngine(const std::string &name, const std::vector<K> &keys, const KeySet &keySet,
+                 size_t size, double loadFactor, const std::string &distribution,
+                 std::vector<Result> &results, Args... args)
+{
+    std::vector<Result> throughput, latency;
+    {
+        EngineType engine(size, loadFactor, args...);
+        runPhases(engine, keys, keySet, size, false, throughput);
+    }
+    {
+        EngineType engine(size, loadFactor, args...);
+        runPhases(engine, keys, keySet, size, true, latency);
+    }
+    for(size_t i{0u}; i < throughput.size(); ++i)
+    {
+        Result result = throughput[i];
+        result.table = name;
+        result.distribution = distribution;
+        result.size = size;
+        result.loadFactor = loadFactor;
+        result.p50 = latency[i].p50;
+        result.p99 = latency[i].p99;
+        result.p999 = latency[i].p999;
+        results.push_back(result);
+    }
+}
+
+template<class K>
+void benchTables(const Options &options, const std::vector<K> &keys, const KeySet &keySet,
+                 size_t size, double loadFactor, const std::string &distribution,
+                 std::vector<Result> &results)
+{
+    using OA = OpenAddressingHashTable<K,uint64_t>;
+    using SeededOA = OpenAddressingHashTable<K,uint64_t,SeededHasher<K>,SeededStepHasher<K>>;
+    using SoaOA = SoaOpenAddressingHashTable<K,uint64_t>;
+    for(const auto &table : options.tables)
+    {
+        std::cerr << table << " " << distribution << " size=" << size
+                  << " lf=" << loadFactor << std::endl;
+        if(table == "chained")
+            benchEngine<Engine<HashTable<K,uint64_t>, K>>(table, keys, keySet, size, loadFactor,
+                                                          distribution, results);
+        else if(table == "oa_linear")
+            benchEngine<Engine<OA, K>>(table, keys, keySet, size, loadFactor, distribution, results,
+                                       CollisionResolutionMethod::LINEAR_PROBING);
+        else if(table == "oa_quadratic")
+            benchEngine<Engine<OA, K>>(table, keys, keySet, size, loadFactor, distribution, results,
+                                       CollisionResolutionMethod::QUADRATIC_PROBING);
+        else if(table == "oa_double")
+            benchEngine<Engine<OA, K>>(table, keys, keySet, size, loadFactor, distribution, results,
+                                       CollisionResolutionMethod::DOUBLE_HASHING);
+        else if(table == "oa_robin_hood")
+            benchEngine<Engine<OA, K>>(table, keys, keySet, size, loadFactor, distribution, results,
+                                       CollisionResolutionMethod::ROBIN_HOOD);
+        else if(table == "swiss")
+            benchEngine<Engine<SwissHashTable<K,uint64_t>, K>>(table, keys, keySet, size,
+                                                               loadFactor, distribution, results);
+        else if(table == "cuckoo")
+            benchEngine<Engine<CuckooHashTable<K,uint64_t>, K>>(table, keys, keySet, size,
+                                                                loadFactor, distribution, results);
+        else if(table == "hopscotch")
+            benchEngine<Engine<HopscotchHashTable<K,uint64_t>, K>>(table, keys, keySet, size,
+                                                                   loadFactor, distribution, results);
+        else if(table == "soa_linear")
+            benchEngine<Engine<SoaOA, K>>(table, keys, keySet, size, loadFactor, distribution,
+                                          results, CollisionResolutionMethod::LINEAR_PROBING);
+        else if(table == "soa_quadratic")
+            benchEngine<Engine<SoaOA, K>>(table, keys, keySet, size, loadFactor, distribution,
+                                          results, CollisionResolutionMethod::QUADRATIC_PROBING);
+        else if(table == "soa_double")
+            benchEngine<Engine<SoaOA, K>>(table, keys, keySet, size, loadFactor, distribution,
+                                          results, CollisionResolutionMethod::DOUBLE_HASHING);
+        else if(table == "soa_robin_hood")
+            benchEngine<Engine<SoaOA, K>>(table, keys, keySet, size, loadFactor, distribution,
+                                          results, CollisionResolutionMethod::ROBIN_HOOD);
+        else if(table == "chained_seeded")
+            benchEngine<Engine<HashTable<K,uint64_t,SeededHasher<K>>, K>>(
+                    table, keys, keySet, size, loadFactor, distribution, results);
+        else if(table == "oa_linear_seeded")
+            benchEngine<Engine<SeededOA, K>>(table, keys, keySet, size, loadFactor, distribution,
+                                             results, CollisionResolutionMethod::LINEAR_PROBING);
+        else if(table == "swiss_seeded")
+            benchEngine<Engine<SwissHashTable<K,uint64_t,SeededHasher<K>>, K>>(
+                    table, keys, keySet, size, loadFactor, distribution, results);
+        else if(table == "std")
+            benchEngine<Engine<std::unordered_map<K,uint64_t>, K>>(table, keys, keySet, size,
+                                                                   loadFactor, distribution,
+                                                                   results);
+        else
+            std::cerr << "Unknown table " << table << std::endl;
+    }
+}
+
+template<class T>
+std::vector<T> parseList(const std::string &text)
+{
+    std::vector<T> items;
+    std::stringstream stream(text);
+    std::string item;
+    while(std::getline(stream, item, ','))
+    {
+        std::stringstream itemStream(item);
+        T value;
+        itemStream >> value;
+        items.push_back(value);
+    }
+    return items;
+}
+
+bool parseOptions(int argc, char *argv[], Options &options)
+{
+    for(int i{1}; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        auto separator = arg.find('=');
+        if(separator == std::string::npos)
+        {
+            std::cerr << "Bad argument " << arg << std::endl;
+            return false;
+        }
+        auto name = arg.substr(0, separator);
+        auto value = arg.substr(separator + 1);
+        if(name == "--sizes") options.sizes = parseList<size_t>(value);
+        else if(name == "--load-factors") options.loadFactors = parseList<double>(value);
+        else if(name == "--distributions") options.distributions = parseList<std::string>(value);
+        else if(name == "--tables") options.tables = parseList<std::string>(value);
+        else if(name == "--format") options.format = value;
+        else if(name == "--seed") options.seed = std::stoull(value);
+        else if(name == "--mode") options.mode = value;
+        else if(name == "--keys-file") options.keysFile = value;
+        else
+        {
+            std::cerr << "Unknown option " << name << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+void printResults(const std::vector<Result> &results, const std::string &format, std::ostream &out)
+{
+    auto mops = [](const Result &result)
+    {
+        return result.seconds > 0.0 ? result.ops / result.seconds / 1e6 : 0.0;
+    };
+    if(format == "json")
+    {
+        out << "[" << std::endl;
+        for(size_t i{0u}; i < results.size(); ++i)
+        {
+            const auto &r = results[i];
+            out << "  {\"table\": \"" << r.table << "\", \"distribution\": \"" << r.distribution
+                << "\", \"size\": " << r.size << ", \"load_factor\": " << r.loadFactor
+                << ", \"operation\": \"" << r.operation << "\", \"ops\": " << r.ops
+                << ", \"seconds\": " << r.seconds << ", \"mops_per_s\": " << mops(r)
+                << ", \"p50_ns\": " << r.p50 << ", \"p99_ns\": " << r.p99
+                << ", \"p999_ns\": " << r.p999 << "}" << (i + 1 < results.size() ? "," : "")
+                << std::endl;
+        }
+        out << "]" << std::endl;
+        return;
+    }
+    out << "table,distribution,size,load_factor,operation,ops,seconds,mops_per_s,"
+           "p50_ns,p99_ns,p999_ns" << std::endl;
+    for(const auto &r : results)
+    {
+        out << r.table << "," << r.distribution << "," << r.size << "," << r.loadFactor << ","
+            << r.operation << "," << r.ops << "," << r.seconds << "," << mops(r) << ","
+            << r.p50 << "," << r.p99 << "," << r.p999 << std::endl;
+    }
+}
+
+struct HashQuality
+{
+    std::string hash;
+    std::string keySet;
+    size_t keys {0u};
+    double chiSquareLow {0.0};      //Chi-square over its degrees of freedom, about 1 is uniform
+    double chiSquareHigh {0.0};
+    double avalancheWorst {0.0};    //|2 * P(output bit flips) - 1|, 0 is ideal
+    double avalancheMean {0.0};
+    double nsPerHash {0.0};
+};
+
+using StringHash = uint64_t (*)(const std::string&);
+
+const std::vector<std::pair<std::string, StringHash>> STRING_HASHES {
+    {"hash_string", [](const std::string &key) -> uint64_t { return hash_string(key.c_str(), SIZE_MAX); }},
+    {"hash_string2", [](const std::string &key) -> uint64_t { return hash_string2(key, SIZE_MAX); }},
+    {"hash_sedgwick", [](const std::string &key) -> uint64_t { return hash_sedgwick(key, SIZE_MAX); }},
+    {"fnv1a", [](const std::string &key) { return hash_bytes(key.data(), key.size()); }},
+    {"fnv1a_mix64", [](const std::string &key) { return mix64(hash_bytes(key.data(), key.size())); }},
+    {"hash_string64", [](const std::string &key) { return hash_string64(key); }},
+    {"siphash13", [](const std::string &key) { return hash_siphash(key.data(), key.size(), 1u, 2u); }}
+};
+
+//Buckets are taken once from the lowest bits (mask reduction) and once from
+//the highest ones (multiplicative reduction), one bucket per 8 keys
+std::pair<double, double> bucketChiSquare(StringHash hash, const std::vector<std::string> &keys)
+{
+    auto bits = std::max(6, int(std::log2(std::max<size_t>(keys.size() / 8, 1u))));
+    size_t buckets = size_t(1) << bits;
+    std::vector<size_t> low(buckets), high(buckets);
+    for(const auto &key : keys)
+    {
+        auto value = hash(key);
+        ++low[value & (buckets - 1)];
+        ++high[value >> (64 - bits)];
+    }
+    auto chiSquare = [&](const std::vector<size_t> &counts)
+    {
+        auto expected = double(keys.size()) / buckets;
+        double sum {0.0};
+        for(auto count : counts)
+            sum += (count - expected) * (count - expected) / expected;
+        return sum / (buckets - 1);
+    };
+    return {chiSquare(low), chiSquare(high)};
+}
+
+//Flips every bit of the first 64 bytes common to all sampled keys and counts,
+//for each pair of input and output bit, how often the output bit changes
+std::pair<double, double> avalancheBias(StringHash hash, const std::vector<std::string> &keys)
+{
+    constexpr size_t SAMPLE_KEYS {1000u};
+    auto samples = std::min(keys.size(), SAMPLE_KEYS);
+    size_t length {64u};
+    for(size_t i{0u}; i < samples; ++i)
+        length = std::min(length, keys[i].size());
+    if(samples == 0 || length == 0) return {0.0, 0.0};
+    std::vector<size_t> flips(length * 8 * 64);
+    for(size_t i{0u}; i < samples; ++i)
+    {
+        auto key = keys[i];
+        auto original = hash(key);
+        for(size_t bit{0u}; bit < length * 8; ++bit)
+        {
+            key[bit / 8] ^= char(1 << (bit % 8));
+            auto changed = hash(key) ^ original;
+            key[bit / 8] ^= char(1 << (bit % 8));
+            for(size_t out{0u}; out < 64; ++out)
+                flips[bit * 64 + out] += (changed >> out) & 1u;
+        }
+    }
+    double worst {0.0}, sum {0.0};
+    for(auto count : flips)
+    {
+        auto bias = std::fabs(2.0 * count / samples - 1.0);
+        worst = std::max(worst, bias);
+        sum += bias;
+    }
+    return {worst, sum / flips.size()};
+}
+
+double nanosecondsPerHash(StringHash hash, const std::vector<std::string> &keys)
+{
+    uint64_t sink {0u};
+    size_t rounds {std::max<size_t>(1u, 1000000u / std::max<size_t>(keys.size(), 1u))};
+    auto start = Clock::now();
+    for(size_t round{0u}; round < rounds; ++round)
+    {
+        for(const auto &key : keys)
+            sink += hash(key);
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    gSink = sink;
+    return elapsed / (rounds * std::max<size_t>(keys.size(), 1u));
+}
+
+void benchHashQuality(const Options &options, std::ostream &out)
+{
+    std::vector<std::pair<std::string, std::vector<std::string>>> keySets;
+    auto size = options.sizes.empty() ? 100000u : options.sizes.front();
+    for(const auto &distribution : {"short_str", "long_str"})
+    {
+        auto keys = makeKeys(distribution, size, options.seed).strings;
+        keys.resize(size);
+        keySets.emplace_back(distribution, std::move(keys));
+    }
+    if(!options.keysFile.empty())
+    {
+        std::ifstream file(options.keysFile);
+        std::vector<std::string> keys;
+        for(std::string line; std::getline(file, line);)
+            keys.push_back(line);
+        keySets.emplace_back(options.keysFile, std::move(keys));
+    }
+
+    std::vector<HashQuality> results;
+    for(const auto &keySet : keySets)
+    {
+        for(const auto &[name, hash] : STRING_HASHES)
+        {
+            std::cerr << name << " " << keySet.first << std::endl;
+            HashQuality quality {name, keySet.first, keySet.second.size()};
+            std::tie(quality.chiSquareLow, quality.chiSquareHigh) = bucketChiSquare(hash, keySet.second);
+            std::tie(quality.avalancheWorst, quality.avalancheMean) = avalancheBias(hash, keySet.second);
+            quality.nsPerHash = nanosecondsPerHash(hash, keySet.second);
+            results.push_back(quality);
+        }
+    }
+
+    if(options.format == "json")
+    {
+        out << "[" << std::endl;
+        for(size_t i{0u}; i < results.size(); ++i)
+        {
+            const auto &r = results[i];
+            out << "  {\"hash\": \"" << r.hash << "\", \"key_set\": \"" << r.keySet
+                << "\", \"keys\": " << r.keys << ", \"chi_square_low\": " << r.chiSquareLow
+                << ", \"chi_square_high\": " << r.chiSquareHigh << ", \"avalanche_worst\": "
+                << r.avalancheWorst << ", \"avalanche_mean\": " << r.avalancheMean
+                << ", \"ns_per_hash\": " << r.nsPerHash << "}"
+                << (i + 1 < results.size() ? "," : "") << std::endl;
+        }
+        out << "]" << std::endl;
+        return;
+    }
+    out << "hash,key_set,keys,chi_square_low,chi_square_high,avalanche_worst,avalanche_mean,"
+           "ns_per_hash" << std::endl;
+    for(const auto &r : results)
+    {
+        out << r.hash << "," << r.keySet << "," << r.keys << "," << r.chiSquareLow << ","
+            << r.chiSquareHigh << "," << r.avalancheWorst << "," << r.avalancheMean << ","
+            << r.nsPerHash << std::endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    if(!parseOptions(argc, argv, options))
+        return 1;
+    if(options.mode == "quality")
+    {
+        benchHashQuality(options, std::cout);
+        return 0;
+    }
+
+    std::vector<Result> results;
+    for(const auto &distribution : options.distributions)
+    {
+        for(auto size : options.sizes)
+        {
+            auto keySet = makeKeys(distribution, size, options.seed);
+            for(auto loadFactor : options.loadFactors)
+            {
+                if(keySet.strings.empty())
+                    benchTables(options, keySet.ints, keySet, size, loadFactor, distribution, results);
+                else
+                    benchTables(options, keySet.strings, keySet, size, loadFactor, distribution,
+                                results);
+            }
+        }
+    }
+    printResults(results, options.format, std::cout);
+    return 0;
+}
@@ -0,0 +1,25 @@
+TEMPLATE = app
+TARGET = bench
+CONFIG += console c++1z thread release
+CONFIG -= app_bundle
+CONFIG -= qt
+
+#Measure the tables without their statistics counters
+DEFINES += HASHTABLE_STATS=0
+
+unix:LIBS += -pthread
+
+SOURCES += bench.cpp \
+    hash_utils.cpp
+
+HEADERS += \
+    hashtable.hpp \
+    array_list.hpp \
+    singly_linked_list.hpp \
+    hash_utils.hpp \
+    swiss_hashtable.hpp \
+    table_stats.hpp \
+    occupancy_bitmap.hpp \
+    cuckoo_hashtable.hpp \
+    hopscotch_hashtable.hpp \
+    soa_hashtable.hpp
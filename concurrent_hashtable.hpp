@@ -0,0 +1,525 @@
+#ifndef CONCURRENT_HASHTABLE_HPP
+#define CONCURRENT_HASHTABLE_HPP
+
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+#include "hashtable.hpp"
+
+//Chained hash table shared between threads. The buckets are guarded by a
+//fixed array of reader/writer stripe locks, bucket i by stripe
+//i % stripesNumber, so operations on different stripes run in parallel and
+//lookups share their stripe. A resize takes every stripe in index order.
+//Values are handed out by copy or to callbacks run under the lock, never by
+//reference, since a reference would outlive the lock. For the same reason
+//there is no operator[], compute() and merge() are the atomic
+//read-modify-write operations. Callbacks must not call back into the table.
+template<class K, class V, class Hasher = DefaultHasher<K>, class KeyEqual = std::equal_to<K>>
+class ConcurrentHashTable final: public Map<K,V>
+{
+public:
+    explicit ConcurrentHashTable(size_t bucketsNumber, size_t stripesNumber = 64u,
+                                 const Hasher &hf = Hasher(),
+                                 const KeyEqual &keyEqual = KeyEqual());
+    ConcurrentHashTable(const ConcurrentHashTable &other) = delete;
+    ConcurrentHashTable& operator=(const ConcurrentHashTable &rhs) = delete;
+    virtual ~ConcurrentHashTable();
+    virtual size_t count() const noexcept override;
+    virtual void insert(const K &key, const V &value) override;
+    virtual void insert(K &&key, V &&value) override;
+    //Builds the value from args when the key is absent. Returns true on insertion
+    template<class... Args>
+    bool try_emplace(const K &key, Args&&... args);
+    template<class... Args>
+    bool try_emplace(K &&key, Args&&... args);
+    template<class M>
+    bool insert_or_assign(const K &key, M &&value);
+    template<class M>
+    bool insert_or_assign(K &&key, M &&value);
+    virtual void update(const K &key, const V &value) override;
+    virtual void remove(const K &key) override;
+    virtual bool find(const K &key, V &value) const override;
+    virtual const V get(const K &key) const override;
+    bool contains(const K &key) const;
+    //Calls f(const V&) under the shared stripe lock, returns false when the key is absent
+    template<class F>
+    bool visit(const K &key, F &&f) const;
+    //Calls f(V&) on the value of the key, default-constructed first when the
+    //key is absent, and returns a copy of the result
+    template<class F>
+    V compute(const K &key, F &&f);
+    //Calls f(V&) only when the key is present, returns false otherwise
+    template<class F>
+    bool computeIfPresent(const K &key, F &&f);
+    //Inserts value when the key is absent, otherwise replaces the stored value
+    //with f(stored, value). Returns a copy of the result
+    template<class F>
+    V merge(const K &key, const V &value, F &&f);
+    //Calls f(key, value) on every item while all the stripes are held shared
+    template<class F>
+    void forEach(F &&f) const;
+    void clear();
+    inline size_t bucketCount() const noexcept { return mBucketsNumber.load(std::memory_order_relaxed); }
+    inline size_t stripeCount() const noexcept { return mStripesNumber; }
+    inline float maxLoadFactor() const noexcept { return mMaxLoadFactor.load(std::memory_order_relaxed); }
+    void setMaxLoadFactor(float maxLoadFactor);
+    void reserve(size_t count);
+    void rehash(size_t bucketsNumber);
+private:
+    using Bucket = LinkedList<Pair<K,V>>;
+    using Buckets = Array<Bucket>;
+    using SharedLock = std::shared_lock<std::shared_mutex>;
+    using UniqueLock = std::unique_lock<std::shared_mutex>;
+
+    //Every stripe on its own cache line, so threads working on neighbouring
+    //stripes do not bounce the same line. The stripe's pool feeds the nodes
+    //of its buckets, it is guarded by the same lock
+    struct alignas(64) Stripe
+    {
+        std::shared_mutex mutex;
+        std::atomic<size_t> count {0u};
+        NodePool<Pair<K,V>> pool;
+    };
+
+    //Holds every stripe, taken in index order like everywhere else
+    template<bool Exclusive>
+    struct StripesGuard
+    {
+        explicit StripesGuard(const ConcurrentHashTable &table);
+        ~StripesGuard();
+        const ConcurrentHashTable &mTable;
+    };
+
+    size_t mStripesNumber;
+    std::unique_ptr<Stripe[]> mStripes;
+    Buckets mBuckets;
+    Hasher mHashFunction;
+    KeyEqual mKeyEqual;
+    std::atomic<size_t> mBucketsNumber;
+    std::atomic<float> mMaxLoadFactor {1.0f};
+
+    void initBuckets(Buckets &buckets);
+    template<class Lock>
+    size_t lockBucket(const K &key, Lock &lock) const;
+    Node<Pair<K,V>>* findIn(const Bucket &bucket, const K &key) const;
+    template<class KeyArg, class... Args>
+    std::pair<Node<Pair<K,V>>*, bool> tryEmplaceIn(size_t index, KeyArg &&key, Args&&... args);
+    void linkNode(Buckets &buckets, Node<Pair<K,V>> *node);
+    void relinkAll(size_t bucketsNumber);
+    void growIfNeeded(size_t index);
+    size_t sumStripeCounts() const noexcept;
+};
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<bool Exclusive>
+ConcurrentHashTable<K,V,Hasher,KeyEqual>::StripesGuard<Exclusive>::StripesGuard(
+        const ConcurrentHashTable &table):
+    mTable(table)
+{
+    for(size_t i{0u}; i < mTable.mStripesNumber; ++i)
+    {
+        if constexpr(Exclusive)
+            mTable.mStripes[i].mutex.lock();
+        else
+            mTable.mStripes[i].mutex.lock_shared();
+    }
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<bool Exclusive>
+ConcurrentHashTable<K,V,Hasher,KeyEqual>::StripesGuard<Exclusive>::~StripesGuard()
+{
+    for(size_t i{mTable.mStripesNumber}; i > 0; --i)
+    {
+        if constexpr(Exclusive)
+            mTable.mStripes[i - 1].mutex.unlock();
+        else
+            mTable.mStripes[i - 1].mutex.unlock_shared();
+    }
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+ConcurrentHashTable<K,V,Hasher,KeyEqual>::ConcurrentHashTable(size_t bucketsNumber,
+                                                              size_t stripesNumber,
+                                                              const Hasher &hf,
+                                                              const KeyEqual &keyEqual):
+    Map<K,V>::Map(), mStripesNumber(stripesNumber ? stripesNumber : 1u),
+    mStripes(new Stripe[mStripesNumber]), mBuckets(getPrimeNumberGreaterThan(bucketsNumber)),
+    mHashFunction(hf), mKeyEqual(keyEqual), mBucketsNumber(mBuckets.capacity())
+{
+    initBuckets(mBuckets);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+ConcurrentHashTable<K,V,Hasher,KeyEqual>::~ConcurrentHashTable()
+{
+    clear();
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+size_t ConcurrentHashTable<K,V,Hasher,KeyEqual>::count() const noexcept
+{
+    return sumStripeCounts();
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void ConcurrentHashTable<K,V,Hasher,KeyEqual>::insert(const K &key, const V &value)
+{
+    insert_or_assign(key, value);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void ConcurrentHashTable<K,V,Hasher,KeyEqual>::insert(K &&key, V &&value)
+{
+    insert_or_assign(std::move(key), std::move(value));
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<class... Args>
+bool ConcurrentHashTable<K,V,Hasher,KeyEqual>::try_emplace(const K &key, Args&&... args)
+{
+    UniqueLock lock;
+    auto index = lockBucket(key, lock);
+    auto isInserted = tryEmplaceIn(index, key, std::forward<Args>(args)...).second;
+    lock.unlock();
+    if(isInserted)
+        growIfNeeded(index);
+    return isInserted;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<class... Args>
+bool ConcurrentHashTable<K,V,Hasher,KeyEqual>::try_emplace(K &&key, Args&&... args)
+{
+    UniqueLock lock;
+    auto index = lockBucket(key, lock);
+    auto isInserted = tryEmplaceIn(index, std::move(key), std::forward<Args>(args)...).second;
+    lock.unlock();
+    if(isInserted)
+        growIfNeeded(index);
+    return isInserted;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<class M>
+bool ConcurrentHashTable<K,V,Hasher,KeyEqual>::insert_or_assign(const K &key, M &&value)
+{
+    UniqueLock lock;
+    auto index = lockBucket(key, lock);
+    auto [node, isInserted] = tryEmplaceIn(index, key, std::forward<M>(value));
+    if(!isInserted)
+        node->data().value = std::forward<M>(value);
+    lock.unlock();
+    if(isInserted)
+        growIfNeeded(index);
+    return isInserted;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<class M>
+bool ConcurrentHashTable<K,V,Hasher,KeyEqual>::insert_or_assign(K &&key, M &&value)
+{
+    UniqueLock lock;
+    auto index = lockBucket(key, lock);
+    auto [node, isInserted] = tryEmplaceIn(index, std::move(key), std::forward<M>(value));
+    if(!isInserted)
+        node->data().value = std::forward<M>(value);
+    lock.unlock();
+    if(isInserted)
+        growIfNeeded(index);
+    return isInserted;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void ConcurrentHashTable<K,V,Hasher,KeyEqual>::update(const K &key, const V &value)
+{
+    computeIfPresent(key, [&value](V &stored){ stored = value; });
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void ConcurrentHashTable<K,V,Hasher,KeyEqual>::remove(const K &key)
+{
+    UniqueLock lock;
+    auto index = lockBucket(key, lock);
+    Bucket &bucket = mBuckets[index];
+    if(auto node = findIn(bucket, key))
+    {
+        bucket.removeAt(node);
+        mStripes[index % mStripesNumber].count.fetch_sub(1u, std::memory_order_relaxed);
+    }
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+bool ConcurrentHashTable<K,V,Hasher,KeyEqual>::find(const K &key, V &value) const
+{
+    return visit(key, [&value](const V &stored){ value = stored; });
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+const V ConcurrentHashTable<K,V,Hasher,KeyEqual>::get(const K &key) const
+{
+    V val {};
+    find(key, val);
+    return val;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+bool ConcurrentHashTable<K,V,Hasher,KeyEqual>::contains(const K &key) const
+{
+    return visit(key, [](const V&){});
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<class F>
+bool ConcurrentHashTable<K,V,Hasher,KeyEqual>::visit(const K &key, F &&f) const
+{
+    SharedLock lock;
+    auto index = lockBucket(key, lock);
+    if(auto node = findIn(mBuckets[index], key))
+    {
+        f(static_cast<const V&>(node->data().value));
+        return true;
+    }
+    return false;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<class F>
+V ConcurrentHashTable<K,V,Hasher,KeyEqual>::compute(const K &key, F &&f)
+{
+    UniqueLock lock;
+    auto index = lockBucket(key, lock);
+    auto [node, isInserted] = tryEmplaceIn(index, key);
+    f(node->data().value);
+    V result = node->data().value;
+    lock.unlock();
+    if(isInserted)
+        growIfNeeded(index);
+    return result;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<class F>
+bool ConcurrentHashTable<K,V,Hasher,KeyEqual>::computeIfPresent(const K &key, F &&f)
+{
+    UniqueLock lock;
+    auto index = lockBucket(key, lock);
+    if(auto node = findIn(mBuckets[index], key))
+    {
+        f(node->data().value);
+        return true;
+    }
+    return false;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<class F>
+V ConcurrentHashTable<K,V,Hasher,KeyEqual>::merge(const K &key, const V &value, F &&f)
+{
+    UniqueLock lock;
+    auto index = lockBucket(key, lock);
+    auto [node, isInserted] = tryEmplaceIn(index, key, value);
+    if(!isInserted)
+        node->data().value = f(static_cast<const V&>(node->data().value), value);
+    V result = node->data().value;
+    lock.unlock();
+    if(isInserted)
+        growIfNeeded(index);
+    return result;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<class F>
+void ConcurrentHashTable<K,V,Hasher,KeyEqual>::forEach(F &&f) const
+{
+    StripesGuard<false> guard(*this);
+    for(size_t i{0u}; i < mBuckets.size(); ++i)
+    {
+        for(auto it = mBuckets[i].head(); it != nullptr; it = it->next())
+            f(it->data().key, static_cast<const V&>(it->data().value));
+    }
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void ConcurrentHashTable<K,V,Hasher,KeyEqual>::clear()
+{
+    StripesGuard<true> guard(*this);
+    for(size_t i{0u}; i < mBuckets.size(); ++i)
+    {
+        if constexpr(std::is_trivially_destructible<Pair<K,V>>::value)
+            mBuckets[i].detachAll();
+        else
+            mBuckets[i].clear();
+    }
+    //Resizes move nodes between stripes, so a slab may still hold nodes of
+    //other stripes: the pools are only released all together
+    for(size_t i{0u}; i < mStripesNumber; ++i)
+    {
+        mStripes[i].pool.release();
+        mStripes[i].count.store(0u, std::memory_order_relaxed);
+    }
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void ConcurrentHashTable<K,V,Hasher,KeyEqual>::setMaxLoadFactor(float maxLoadFactor)
+{
+    if(maxLoadFactor <= 0.0f) return;
+    mMaxLoadFactor.store(maxLoadFactor, std::memory_order_relaxed);
+    if(count() > maxLoadFactor * bucketCount())
+        rehash(bucketCount());
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void ConcurrentHashTable<K,V,Hasher,KeyEqual>::reserve(size_t count)
+{
+    rehash(size_t(std::ceil(count / maxLoadFactor())));
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void ConcurrentHashTable<K,V,Hasher,KeyEqual>::rehash(size_t bucketsNumber)
+{
+    StripesGuard<true> guard(*this);
+    auto required = size_t(std::ceil(sumStripeCounts() / maxLoadFactor()));
+    auto newBucketsNumber = getPrimeNumberNotLessThan(std::max(bucketsNumber, required));
+    if(newBucketsNumber != mBuckets.size())
+        relinkAll(newBucketsNumber);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void ConcurrentHashTable<K,V,Hasher,KeyEqual>::initBuckets(Buckets &buckets)
+{
+    for(size_t i{buckets.size()}; i < buckets.capacity(); ++i)
+        buckets.emplace_back();
+    for(size_t i{0u}; i < buckets.size(); ++i)
+        buckets[i].setPool(&mStripes[i % mStripesNumber].pool);
+}
+
+//Locks the stripe of the key's bucket and returns the bucket index. The
+//bucket count is read before the lock is taken, so it is checked again under
+//the lock, a resize in between means another try
+template<class K, class V, class Hasher, class KeyEqual>
+template<class Lock>
+size_t ConcurrentHashTable<K,V,Hasher,KeyEqual>::lockBucket(const K &key, Lock &lock) const
+{
+    for(;;)
+    {
+        auto bucketsNumber = mBucketsNumber.load(std::memory_order_acquire);
+        auto index = mHashFunction(key, bucketsNumber);
+        lock = Lock(mStripes[index % mStripesNumber].mutex);
+        if(bucketsNumber == mBuckets.size())
+            return index;
+        lock.unlock();
+    }
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+Node<Pair<K,V>>* ConcurrentHashTable<K,V,Hasher,KeyEqual>::findIn(const Bucket &bucket,
+                                                                  const K &key) const
+{
+    auto it = bucket.head();
+    while(it && key > it->data().key)
+        it = it->next();
+    return it && mKeyEqual(it->data().key, key) ? it : nullptr;
+}
+
+//Same ordered chain insertion as HashTable::tryEmplaceNode, the caller holds
+//the stripe of the bucket exclusively
+template<class K, class V, class Hasher, class KeyEqual>
+template<class KeyArg, class... Args>
+std::pair<Node<Pair<K,V>>*, bool> ConcurrentHashTable<K,V,Hasher,KeyEqual>::tryEmplaceIn(
+        size_t index, KeyArg &&key, Args&&... args)
+{
+    Bucket &bucket = mBuckets[index];
+    Node<Pair<K,V>> *node {nullptr};
+
+    if(bucket.isEmpty() || key < bucket.head()->data().key)
+    {
+        node = bucket.emplaceFront(std::forward<KeyArg>(key),
+                                   makeInPlaceValue<V>(std::forward<Args>(args)...));
+    }
+    else
+    {
+        auto it = bucket.head();
+        auto prev = it;
+        while(it && key > it->data().key)
+        {
+            prev = it;
+            it = it->next();
+        }
+        if(it && mKeyEqual(it->data().key, key))
+            return {it, false};
+        node = bucket.emplaceAt(prev, std::forward<KeyArg>(key),
+                                makeInPlaceValue<V>(std::forward<Args>(args)...));
+    }
+    mStripes[index % mStripesNumber].count.fetch_add(1u, std::memory_order_relaxed);
+    return {node, true};
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void ConcurrentHashTable<K,V,Hasher,KeyEqual>::linkNode(Buckets &buckets, Node<Pair<K,V>> *node)
+{
+    const K &key = node->data().key;
+    Bucket &bucket = buckets[mHashFunction(key, buckets.size())];
+    if(bucket.isEmpty() || key < bucket.head()->data().key)
+    {
+        bucket.pushFrontNode(node);
+        return;
+    }
+    auto prev = bucket.head();
+    while(prev->next() && prev->next()->data().key < key)
+        prev = prev->next();
+    bucket.insertNodeAt(prev, node);
+}
+
+//Relinks every node into a new bucket array, the caller holds all the stripes.
+//Buckets change stripes with the new size, so the stripe counts are redone
+template<class K, class V, class Hasher, class KeyEqual>
+void ConcurrentHashTable<K,V,Hasher,KeyEqual>::relinkAll(size_t bucketsNumber)
+{
+    Buckets newBuckets(bucketsNumber);
+    initBuckets(newBuckets);
+    for(size_t i{0u}; i < mBuckets.size(); ++i)
+    {
+        while(auto node = mBuckets[i].releaseFront())
+            linkNode(newBuckets, node);
+    }
+    mBuckets = std::move(newBuckets);
+    for(size_t i{0u}; i < mStripesNumber; ++i)
+        mStripes[i].count.store(0u, std::memory_order_relaxed);
+    for(size_t i{0u}; i < mBuckets.size(); ++i)
+        mStripes[i % mStripesNumber].count.fetch_add(mBuckets[i].count(), std::memory_order_relaxed);
+    mBucketsNumber.store(mBuckets.size(), std::memory_order_release);
+}
+
+//The stripe that just grew stands for the average one, which keeps the
+//common case free of other stripes' cache lines. The exact count is only
+//taken once the estimate crosses the limit and every stripe is held
+template<class K, class V, class Hasher, class KeyEqual>
+void ConcurrentHashTable<K,V,Hasher,KeyEqual>::growIfNeeded(size_t index)
+{
+    auto bucketsNumber = mBucketsNumber.load(std::memory_order_relaxed);
+    auto stripeCount = mStripes[index % mStripesNumber].count.load(std::memory_order_relaxed);
+    auto usedStripes = std::min(mStripesNumber, bucketsNumber);
+    if(float(stripeCount * usedStripes) <= maxLoadFactor() * bucketsNumber)
+        return;
+
+    StripesGuard<true> guard(*this);
+    //Another thread may have resized while this one waited for the stripes
+    if(mBuckets.size() != bucketsNumber || float(sumStripeCounts()) <= maxLoadFactor() * bucketsNumber)
+        return;
+    relinkAll(getPrimeNumberGreaterThan(2 * bucketsNumber));
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+size_t ConcurrentHashTable<K,V,Hasher,KeyEqual>::sumStripeCounts() const noexcept
+{
+    size_t total {0u};
+    for(size_t i{0u}; i < mStripesNumber; ++i)
+        total += mStripes[i].count.load(std::memory_order_relaxed);
+    return total;
+}
+
+#endif // CONCURRENT_HASHTABLE_HPP
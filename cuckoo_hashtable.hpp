@@ -0,0 +1,656 @@
+#ifndef CUCKOO_HASHTABLE_HPP
+#define CUCKOO_HASHTABLE_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <new>
+#include <utility>
+#include <vector>
+#include "hashtable.hpp"
+
+//Bucketized cuckoo hashing: a key lives in one of 4 slots of one of two
+//buckets, picked by the Hasher and Hasher2 pair that double hashing uses, or
+//in a stash of at most STASH_SIZE pairs. A lookup therefore reads at most two
+//buckets whatever the load. Buckets are aligned on cache lines, a bucket of
+//4 pairs of up to 16 bytes takes one line, larger pairs take several.
+//The tag bytes of the slots, 0 when free, otherwise the high bit and 7 bits
+//of the hash, live apart in a dense array, 4 bytes per bucket, and a key is
+//compared on a tag match alone. A hit in the first bucket reads one tag line
+//and one bucket line, a hit in the second one two tag lines and one bucket
+//line. A miss reads the two tag lines and, when the stash is not empty, the
+//stash as well. Tags kept in the buckets would save the tag lines but push a
+//bucket of 16 byte pairs to 68 bytes, two lines.
+//An insertion finding both buckets full searches breadth first for the
+//shortest chain of displacements ending in a free slot. When there is none
+//the key goes to the stash, and a full stash makes the table grow.
+//The one exception is a key whose two full hashes equal those of every
+//resident of both its buckets: no number of buckets ever separates them, so
+//it joins the stash beyond STASH_SIZE, which only a broken hash function
+//brings about.
+template<class K, class V, class Hasher = DefaultHasher<K>, class Hasher2 = DefaultStepHasher<K>,
+         class KeyEqual = std::equal_to<K>>
+class CuckooHashTable final: public Map<K,V>
+{
+public:
+    static constexpr size_t SLOTS {4u};             //Slots per bucket
+    static constexpr size_t STASH_SIZE {8u};
+
+    explicit CuckooHashTable(size_t tableSize = 0u, const Hasher &hf = Hasher(),
+                             const Hasher2 &hf2 = Hasher2(), const KeyEqual &keyEqual = KeyEqual());
+    CuckooHashTable(const CuckooHashTable &other);
+    CuckooHashTable(CuckooHashTable &&other) noexcept;
+    CuckooHashTable& operator=(const CuckooHashTable &rhs);
+    CuckooHashTable& operator=(CuckooHashTable &&rhs) noexcept;
+    virtual ~CuckooHashTable();
+    virtual void insert(const K &key, const V &value) override;
+    virtual void insert(K &&key, V &&value) override;
+    //Builds the value from args when the key is absent, otherwise leaves the
+    //table and the arguments untouched. Returns true on insertion
+    template<class... Args>
+    bool try_emplace(const K &key, Args&&... args);
+    template<class... Args>
+    bool try_emplace(K &&key, Args&&... args);
+    //Assigns the value of an existing key without touching the key
+    template<class M>
+    bool insert_or_assign(const K &key, M &&value);
+    template<class M>
+    bool insert_or_assign(K &&key, M &&value);
+    virtual void update(const K &key, const V &value) override;
+    void update(const K &key, V &&value);
+    virtual void remove(const K &key) override;
+    virtual bool find(const K &key, V &value) const override;
+    virtual const V get(const K &key) const override;
+    V& operator[](const K &key);
+    const V operator[](const K &key) const;
+    void clear();
+    virtual void print() const;
+    inline size_t bucketCount() const noexcept { return mBucketsNumber; }
+    inline size_t capacity() const noexcept { return mBucketsNumber * SLOTS; }
+    inline double loadFactor() const noexcept { return double(mCount) / capacity(); }
+    inline double maxLoadFactor() const noexcept { return mMaxLoadFactor; }
+    void setMaxLoadFactor(double maxLoadFactor);
+    inline size_t stashSize() const noexcept { return mStash.size(); }
+    void reserve(size_t count);
+protected:
+    using Map<K,V>::mCount;
+private:
+    struct alignas(64) Bucket
+    {
+        alignas(Pair<K,V>) unsigned char storage[SLOTS * sizeof(Pair<K,V>)];
+        inline Pair<K,V>& slot(size_t i) noexcept
+        {
+            return std::launder(reinterpret_cast<Pair<K,V>*>(storage))[i];
+        }
+        inline const Pair<K,V>& slot(size_t i) const noexcept
+        {
+            return std::launder(reinterpret_cast<const Pair<K,V>*>(storage))[i];
+        }
+    };
+    //Location of a key: slot of a bucket, or position in the stash when
+    //bucket is NO_BUCKET
+    struct Position
+    {
+        size_t bucket;
+        size_t slot;
+    };
+    //Node of the displacement search: the item in slot of the parent's
+    //bucket can move to bucket
+    struct PathNode
+    {
+        size_t bucket;
+        size_t parent;
+        size_t slot;
+    };
+    static constexpr size_t NO_BUCKET {SIZE_MAX};
+    static constexpr size_t MAX_SEARCHED_BUCKETS {512u};
+
+    Bucket *mBuckets {nullptr};
+    size_t mBucketsNumber {0u};
+    std::vector<uint8_t> mTags;     //SLOTS tags per bucket
+    std::vector<Pair<K,V>> mStash;
+    double mMaxLoadFactor {0.95};
+    Hasher mHashFunction;
+    Hasher2 mHashFunction2;
+    KeyEqual mKeyEqual;
+
+    static inline uint8_t tagOf(size_t hash) noexcept { return uint8_t(0x80 | (hash & 0x7f)); }
+    inline size_t firstBucket(size_t hash) const noexcept { return fibonacci_hash(hash, mBucketsNumber); }
+    inline size_t secondBucket(const K &key) const
+    {
+        return fibonacci_hash(fullHash(mHashFunction2, key), mBucketsNumber);
+    }
+    inline uint8_t& tag(size_t bucket, size_t slot) noexcept { return mTags[bucket * SLOTS + slot]; }
+    inline uint8_t tag(size_t bucket, size_t slot) const noexcept { return mTags[bucket * SLOTS + slot]; }
+    inline size_t otherBucket(const K &key, size_t bucket) const;
+    bool isInseparable(const K &key, size_t hash, size_t first, size_t second) const;
+    size_t findInBucket(size_t bucket, uint8_t tag, const K &key) const;
+    bool has(const K &key, Position &pos) const;
+    inline Pair<K,V>& at(const Position &pos) noexcept;
+    inline const Pair<K,V>& at(const Position &pos) const noexcept;
+    template<class KeyArg, class... Args>
+    std::pair<Position, bool> tryEmplaceSlot(KeyArg &&key, Args&&... args);
+    bool place(Pair<K,V> &&item, size_t hash, Position &pos);
+    bool displace(size_t first, size_t second, size_t &bucket, size_t &slot);
+    void fillSlot(size_t bucket, size_t slot, uint8_t tag, Pair<K,V> &&item);
+    void destroySlot(size_t bucket, size_t slot) noexcept;
+    void unstash(size_t bucket);
+    void allocate(size_t bucketsNumber);
+    void release() noexcept;
+    void resize(size_t bucketsNumber);
+};
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::CuckooHashTable(size_t tableSize, const Hasher &hf,
+                                                              const Hasher2 &hf2,
+                                                              const KeyEqual &keyEqual):
+    Map<K,V>::Map(), mHashFunction(hf), mHashFunction2(hf2), mKeyEqual(keyEqual)
+{
+    allocate(getPowerOfTwoNotLessThan(std::max<size_t>(2u, size_t(tableSize / mMaxLoadFactor) / SLOTS + 1)));
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::CuckooHashTable(const CuckooHashTable &other):
+    Map<K,V>::Map(other), mMaxLoadFactor(other.mMaxLoadFactor),
+    mHashFunction(other.mHashFunction), mHashFunction2(other.mHashFunction2),
+    mKeyEqual(other.mKeyEqual)
+{
+    mCount = 0;
+    allocate(other.mBucketsNumber);
+    for(size_t b{0u}; b < other.mBucketsNumber; ++b)
+    {
+        for(size_t i{0u}; i < SLOTS; ++i)
+        {
+            if(other.tag(b, i))
+                insert(other.mBuckets[b].slot(i).key, other.mBuckets[b].slot(i).value);
+        }
+    }
+    for(const auto &item : other.mStash)
+        insert(item.key, item.value);
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::CuckooHashTable(CuckooHashTable &&other) noexcept:
+    Map<K,V>::Map(other), mBuckets(other.mBuckets), mBucketsNumber(other.mBucketsNumber),
+    mTags(std::move(other.mTags)), mStash(std::move(other.mStash)), mMaxLoadFactor(other.mMaxLoadFactor),
+    mHashFunction(std::move(other.mHashFunction)),
+    mHashFunction2(std::move(other.mHashFunction2)), mKeyEqual(std::move(other.mKeyEqual))
+{
+    other.mBuckets = nullptr;
+    other.mBucketsNumber = 0;
+    other.mCount = 0;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>& CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::operator=(
+        const CuckooHashTable &rhs)
+{
+    if(this == &rhs) return *this;
+    CuckooHashTable copy(rhs);
+    return *this = std::move(copy);
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>& CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::operator=(
+        CuckooHashTable &&rhs) noexcept
+{
+    if(this == &rhs) return *this;
+    release();
+    std::swap(mBuckets, rhs.mBuckets);
+    std::swap(mBucketsNumber, rhs.mBucketsNumber);
+    std::swap(mTags, rhs.mTags);
+    std::swap(mCount, rhs.mCount);
+    mStash = std::move(rhs.mStash);
+    mMaxLoadFactor = rhs.mMaxLoadFactor;
+    mHashFunction = std::move(rhs.mHashFunction);
+    mHashFunction2 = std::move(rhs.mHashFunction2);
+    mKeyEqual = std::move(rhs.mKeyEqual);
+    return *this;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::~CuckooHashTable()
+{
+    release();
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::insert(const K &key, const V &value)
+{
+    insert_or_assign(key, value);
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::insert(K &&key, V &&value)
+{
+    insert_or_assign(std::move(key), std::move(value));
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+template<class... Args>
+bool CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::try_emplace(const K &key, Args&&... args)
+{
+    return tryEmplaceSlot(key, std::forward<Args>(args)...).second;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+template<class... Args>
+bool CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::try_emplace(K &&key, Args&&... args)
+{
+    return tryEmplaceSlot(std::move(key), std::forward<Args>(args)...).second;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+template<class M>
+bool CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::insert_or_assign(const K &key, M &&value)
+{
+    auto [pos, isInserted] = tryEmplaceSlot(key, std::forward<M>(value));
+    if(!isInserted)
+        at(pos).value = std::forward<M>(value);
+    return isInserted;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+template<class M>
+bool CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::insert_or_assign(K &&key, M &&value)
+{
+    auto [pos, isInserted] = tryEmplaceSlot(std::move(key), std::forward<M>(value));
+    if(!isInserted)
+        at(pos).value = std::forward<M>(value);
+    return isInserted;
+}
+
+//The pair is built before a place is searched, since displacements move
+//whole pairs around. The table grows first when the load would get too
+//high, and again as long as neither a displacement chain nor the stash
+//can take the pair
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+template<class KeyArg, class... Args>
+auto CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::tryEmplaceSlot(KeyArg &&key, Args&&... args)
+        -> std::pair<Position, bool>
+{
+    Position pos;
+    if(has(key, pos))
+        return {pos, false};
+    if(double(mCount + 1) > mMaxLoadFactor * capacity())
+        resize(mBucketsNumber * 2);
+    Pair<K,V> item{std::forward<KeyArg>(key), makeInPlaceValue<V>(std::forward<Args>(args)...)};
+    auto hash = fullHash(mHashFunction, item.key);
+    while(!place(std::move(item), hash, pos))
+        resize(mBucketsNumber * 2);
+    ++mCount;
+    return {pos, true};
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::update(const K &key, const V &value)
+{
+    Position pos;
+    if(has(key, pos))
+        at(pos).value = value;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::update(const K &key, V &&value)
+{
+    Position pos;
+    if(has(key, pos))
+        at(pos).value = std::move(value);
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::remove(const K &key)
+{
+    Position pos;
+    if(!has(key, pos)) return;
+    --mCount;
+    if(pos.bucket == NO_BUCKET)
+    {
+        mStash.erase(mStash.begin() + pos.slot);
+        return;
+    }
+    destroySlot(pos.bucket, pos.slot);
+    unstash(pos.bucket);
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+bool CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::find(const K &key, V &value) const
+{
+    Position pos;
+    if(has(key, pos))
+    {
+        value = at(pos).value;
+        return true;
+    }
+    return false;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+const V CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::get(const K &key) const
+{
+    V value {};
+    find(key, value);
+    return value;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+V& CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::operator[](const K &key)
+{
+    return at(tryEmplaceSlot(key).first).value;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+const V CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::operator[](const K &key) const
+{
+    return get(key);
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::clear()
+{
+    for(size_t b{0u}; b < mBucketsNumber; ++b)
+    {
+        for(size_t i{0u}; i < SLOTS; ++i)
+        {
+            if(tag(b, i))
+                destroySlot(b, i);
+        }
+    }
+    mStash.clear();
+    mCount = 0;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::print() const
+{
+    for(size_t b{0u}; b < mBucketsNumber; ++b)
+    {
+        std::cout << "| " << b << " |";
+        for(size_t i{0u}; i < SLOTS; ++i)
+        {
+            if(tag(b, i))
+                std::cout << " (" << mBuckets[b].slot(i).key << "," << mBuckets[b].slot(i).value << ")";
+            else
+                std::cout << " Empty";
+        }
+        std::cout << std::endl;
+    }
+    std::cout << "Stash:";
+    for(const auto &item : mStash)
+        std::cout << " (" << item.key << "," << item.value << ")";
+    std::cout << std::endl;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::setMaxLoadFactor(double maxLoadFactor)
+{
+    if(maxLoadFactor <= 0.0 || maxLoadFactor >= 1.0) return;
+    mMaxLoadFactor = maxLoadFactor;
+    if(loadFactor() > mMaxLoadFactor)
+        reserve(mCount);
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::reserve(size_t count)
+{
+    auto bucketsNumber = getPowerOfTwoNotLessThan(size_t(count / mMaxLoadFactor) / SLOTS + 1);
+    if(bucketsNumber > mBucketsNumber)
+        resize(bucketsNumber);
+}
+
+//Either bucket of a key gives the other one. A key whose two buckets
+//coincide has no other place and is never displaced
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+inline size_t CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::otherBucket(const K &key,
+                                                                         size_t bucket) const
+{
+    auto first = firstBucket(fullHash(mHashFunction, key));
+    return first == bucket ? secondBucket(key) : first;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+size_t CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::findInBucket(size_t bucket, uint8_t tag,
+                                                                  const K &key) const
+{
+    for(size_t i{0u}; i < SLOTS; ++i)
+    {
+        if(this->tag(bucket, i) == tag && mKeyEqual(mBuckets[bucket].slot(i).key, key))
+            return i;
+    }
+    return SLOTS;
+}
+
+//The second hash is only computed when the first bucket misses
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+bool CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::has(const K &key, Position &pos) const
+{
+    auto hash = fullHash(mHashFunction, key);
+    auto tag = tagOf(hash);
+    pos.bucket = firstBucket(hash);
+    pos.slot = findInBucket(pos.bucket, tag, key);
+    if(pos.slot < SLOTS)
+        return true;
+    pos.bucket = secondBucket(key);
+    pos.slot = findInBucket(pos.bucket, tag, key);
+    if(pos.slot < SLOTS)
+        return true;
+    pos.bucket = NO_BUCKET;
+    for(pos.slot = 0; pos.slot < mStash.size(); ++pos.slot)
+    {
+        if(mKeyEqual(mStash[pos.slot].key, key))
+            return true;
+    }
+    return false;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+inline Pair<K,V>& CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::at(const Position &pos) noexcept
+{
+    return pos.bucket == NO_BUCKET ? mStash[pos.slot] : mBuckets[pos.bucket].slot(pos.slot);
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+inline const Pair<K,V>& CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::at(
+        const Position &pos) const noexcept
+{
+    return pos.bucket == NO_BUCKET ? mStash[pos.slot] : mBuckets[pos.bucket].slot(pos.slot);
+}
+
+//Places a pair whose key is absent and returns where. Returns false, with
+//the pair untouched, when the table has to grow first
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+bool CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::place(Pair<K,V> &&item, size_t hash,
+                                                         Position &pos)
+{
+    auto first = firstBucket(hash);
+    auto second = secondBucket(item.key);
+    if(displace(first, second, pos.bucket, pos.slot))
+    {
+        fillSlot(pos.bucket, pos.slot, tagOf(hash), std::move(item));
+        return true;
+    }
+    if(mStash.size() >= STASH_SIZE && !isInseparable(item.key, hash, first, second))
+        return false;
+    mStash.push_back(std::move(item));
+    pos = {NO_BUCKET, mStash.size() - 1};
+    return true;
+}
+
+//Frees a slot in the first or the second bucket: breadth first search over
+//the items that could move to their other bucket, up to MAX_SEARCHED_BUCKETS
+//buckets, then the shortest chain found is shifted from its free end. A
+//bucket appears at most once on a chain, so every move lands in a slot that
+//is still free
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+bool CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::displace(size_t first, size_t second,
+                                                            size_t &bucket, size_t &slot)
+{
+    auto freeSlot = [this](size_t b)
+    {
+        for(size_t i{0u}; i < SLOTS; ++i)
+        {
+            if(!tag(b, i))
+                return i;
+        }
+        return SLOTS;
+    };
+    //Most insertions find room right away and need no search
+    for(auto b : {first, second})
+    {
+        slot = freeSlot(b);
+        if(slot < SLOTS)
+        {
+            bucket = b;
+            return true;
+        }
+    }
+    std::vector<PathNode> nodes;
+    nodes.reserve(std::min(MAX_SEARCHED_BUCKETS, 2 * mBucketsNumber));
+    nodes.push_back({first, NO_BUCKET, 0u});
+    if(second != first)
+        nodes.push_back({second, NO_BUCKET, 0u});
+    auto isOnChain = [&nodes](size_t node, size_t b)
+    {
+        for(; node != NO_BUCKET; node = nodes[node].parent)
+        {
+            if(nodes[node].bucket == b)
+                return true;
+        }
+        return false;
+    };
+
+    for(size_t n{0u}; n < nodes.size(); ++n)
+    {
+        auto freeIndex = freeSlot(nodes[n].bucket);
+        if(freeIndex < SLOTS)
+        {
+            for(; nodes[n].parent != NO_BUCKET; n = nodes[n].parent)
+            {
+                auto &from = mBuckets[nodes[nodes[n].parent].bucket];
+                auto fromIndex = nodes[n].slot;
+                fillSlot(nodes[n].bucket, freeIndex, tag(nodes[nodes[n].parent].bucket, fromIndex),
+                         std::move(from.slot(fromIndex)));
+                destroySlot(nodes[nodes[n].parent].bucket, fromIndex);
+                freeIndex = fromIndex;
+            }
+            bucket = nodes[n].bucket;
+            slot = freeIndex;
+            return true;
+        }
+        for(size_t i{0u}; i < SLOTS && nodes.size() < MAX_SEARCHED_BUCKETS; ++i)
+        {
+            auto other = otherBucket(mBuckets[nodes[n].bucket].slot(i).key, nodes[n].bucket);
+            if(!isOnChain(n, other))
+                nodes.push_back({other, n, i});
+        }
+    }
+    return false;
+}
+
+//True when both buckets are full of keys having the same two full hashes as
+//key, which stay in these same two buckets whatever the number of buckets
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+bool CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::isInseparable(const K &key, size_t hash,
+                                                                 size_t first, size_t second) const
+{
+    auto hash2 = fullHash(mHashFunction2, key);
+    for(auto b : {first, second})
+    {
+        for(size_t i{0u}; i < SLOTS; ++i)
+        {
+            const K &resident = mBuckets[b].slot(i).key;
+            if(fullHash(mHashFunction, resident) != hash || fullHash(mHashFunction2, resident) != hash2)
+                return false;
+        }
+    }
+    return true;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::fillSlot(size_t bucket, size_t slot,
+                                                            uint8_t tag, Pair<K,V> &&item)
+{
+    new (&mBuckets[bucket].slot(slot)) Pair<K,V>(std::move(item));
+    this->tag(bucket, slot) = tag;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::destroySlot(size_t bucket, size_t slot) noexcept
+{
+    mBuckets[bucket].slot(slot).~Pair<K,V>();
+    tag(bucket, slot) = 0u;
+}
+
+//A removal frees a slot of bucket, which may be one of the two buckets of a
+//stashed key
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::unstash(size_t bucket)
+{
+    for(size_t i{0u}; i < mStash.size(); ++i)
+    {
+        auto hash = fullHash(mHashFunction, mStash[i].key);
+        if(firstBucket(hash) != bucket && secondBucket(mStash[i].key) != bucket)
+            continue;
+        for(size_t s{0u}; s < SLOTS; ++s)
+        {
+            if(!tag(bucket, s))
+            {
+                fillSlot(bucket, s, tagOf(hash), std::move(mStash[i]));
+                mStash.erase(mStash.begin() + i);
+                return;
+            }
+        }
+    }
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::allocate(size_t bucketsNumber)
+{
+    mBucketsNumber = bucketsNumber;
+    mBuckets = static_cast<Bucket*>(::operator new(bucketsNumber * sizeof(Bucket),
+                                                   std::align_val_t{alignof(Bucket)}));
+    mTags.assign(bucketsNumber * SLOTS, 0u);
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::release() noexcept
+{
+    if(!mBuckets) return;
+    clear();
+    ::operator delete(mBuckets, std::align_val_t{alignof(Bucket)});
+    mBuckets = nullptr;
+    mBucketsNumber = 0;
+}
+
+//Placing the old pairs can fill the capped stash again, in which case the
+//table grows once more before the rest are placed
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void CuckooHashTable<K,V,Hasher,Hasher2,KeyEqual>::resize(size_t bucketsNumber)
+{
+    auto oldBuckets = mBuckets;
+    auto oldBucketsNumber = mBucketsNumber;
+    auto oldTags = std::move(mTags);
+    auto oldStash = std::move(mStash);
+    mStash.clear();
+    allocate(bucketsNumber);
+    Position pos;
+    auto move = [this, &pos](Pair<K,V> &item)
+    {
+        auto hash = fullHash(mHashFunction, item.key);
+        while(!place(std::move(item), hash, pos))
+            resize(mBucketsNumber * 2);
+    };
+    for(size_t b{0u}; b < oldBucketsNumber; ++b)
+    {
+        for(size_t i{0u}; i < SLOTS; ++i)
+        {
+            if(!oldTags[b * SLOTS + i]) continue;
+            move(oldBuckets[b].slot(i));
+            oldBuckets[b].slot(i).~Pair<K,V>();
+        }
+    }
+    for(auto &item : oldStash)
+        move(item);
+    ::operator delete(oldBuckets, std::align_val_t{alignof(Bucket)});
+}
+
+#endif // CUCKOO_HASHTABLE_HPP
@@ -1,5 +1,13 @@
 #include "hash_utils.hpp"
-#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <random>
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define HASH_UTILS_X86 1
+#endif
 
 #define HASH32_S 2654435769
 
@@ -22,7 +30,6 @@ size_t hash_string(const char* str, size_t m)
     size_t a {7};
     while(getGreatestCommonDivisor(a,m) > 1)
         a = getPrimeNumberGreaterThan(a);
-    std::cout << "a= " << a << std::endl;
     size_t hash {0};
     for(; *str != 0; ++str)
         hash = (hash + a + *str) % m;
@@ -50,6 +57,321 @@ size_t hash_sedgwick(const std::string &keyString, size_t hashSize)
     return hash;
 }
 
+namespace
+{
+
+constexpr uint64_t WY_P0 {0xa0761d6478bd642fULL};
+constexpr uint64_t WY_P1 {0xe7037ed1a0b428dbULL};
+constexpr uint64_t WY_P2 {0x8ebc6af09c88c6e3ULL};
+constexpr uint64_t WY_P3 {0x589965cc75374cc3ULL};
+constexpr uint64_t SCRAMBLE_PRIME {0x9e3779b1ULL};
+
+constexpr int SIP_C_ROUNDS {1};             //SipHash-1-3: one round per word,
+constexpr int SIP_D_ROUNDS {3};             //three to finish
+
+constexpr size_t LONG_KEY_SIZE {256u};
+constexpr size_t STRIPE_SIZE {64u};         //Eight 64 bit lanes
+constexpr size_t STRIPES_PER_BLOCK {16u};   //Accumulators are scrambled after each block
+constexpr size_t SECRET_WORDS {32u};
+constexpr size_t LAST_STRIPE_SECRET {17u};  //Secret offsets, in words, of the last
+constexpr size_t MERGE_SECRET {8u};         //stripe, of the final merge and of the
+constexpr size_t SCRAMBLE_SECRET {24u};     //scramble
+
+//Stripe s of a block is keyed with the words s..s+7 of the secret
+struct Secret
+{
+    uint64_t words[SECRET_WORDS];
+};
+
+//splitmix64 output, fixed at compile time
+constexpr Secret makeSecret()
+{
+    Secret secret {};
+    uint64_t state {0u};
+    for(size_t i{0u}; i < SECRET_WORDS; ++i)
+    {
+        state += 0x9e3779b97f4a7c15ULL;
+        auto z = state;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        secret.words[i] = z ^ (z >> 31);
+    }
+    return secret;
+}
+
+constexpr Secret SECRET {makeSecret()};
+
+inline uint64_t read64(const char *data) noexcept
+{
+    uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+inline uint64_t read32(const char *data) noexcept
+{
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+//Full 128 bit product, low half into a and high half into b
+inline void multiply128(uint64_t &a, uint64_t &b) noexcept
+{
+    auto product = static_cast<unsigned __int128>(a) * b;
+    a = static_cast<uint64_t>(product);
+    b = static_cast<uint64_t>(product >> 64);
+}
+
+inline uint64_t multiplyFold(uint64_t a, uint64_t b) noexcept
+{
+    multiply128(a, b);
+    return a ^ b;
+}
+
+//Every lane adds the product of the low and high halves of its keyed input
+//and, so no input bit is lost in the product, the raw input of its neighbour
+[[maybe_unused]]
+void accumulateScalar(uint64_t *acc, const char *data, const uint64_t *secret, size_t stripes)
+{
+    for(size_t s{0u}; s < stripes; ++s)
+    {
+        for(size_t lane{0u}; lane < 8u; ++lane)
+        {
+            auto value = read64(data + s * STRIPE_SIZE + lane * 8u);
+            auto keyed = value ^ secret[s + lane];
+            acc[lane ^ 1u] += value;
+            acc[lane] += (keyed & 0xffffffffu) * (keyed >> 32);
+        }
+    }
+}
+
+#ifdef HASH_UTILS_X86
+
+//x86-64 always has SSE2
+void accumulateSse2(uint64_t *acc, const char *data, const uint64_t *secret, size_t stripes)
+{
+    __m128i lanes[4];
+    for(size_t i{0u}; i < 4u; ++i)
+        lanes[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc) + i);
+    for(size_t s{0u}; s < stripes; ++s)
+    {
+        auto input = reinterpret_cast<const __m128i*>(data + s * STRIPE_SIZE);
+        auto key = reinterpret_cast<const __m128i*>(secret + s);
+        for(size_t i{0u}; i < 4u; ++i)
+        {
+            auto value = _mm_loadu_si128(input + i);
+            auto keyed = _mm_xor_si128(value, _mm_loadu_si128(key + i));
+            auto product = _mm_mul_epu32(keyed, _mm_srli_epi64(keyed, 32));
+            auto swapped = _mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+            lanes[i] = _mm_add_epi64(lanes[i], _mm_add_epi64(product, swapped));
+        }
+    }
+    for(size_t i{0u}; i < 4u; ++i)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(acc) + i, lanes[i]);
+}
+
+__attribute__((target("avx2")))
+void accumulateAvx2(uint64_t *acc, const char *data, const uint64_t *secret, size_t stripes)
+{
+    __m256i lanes[2];
+    for(size_t i{0u}; i < 2u; ++i)
+        lanes[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc) + i);
+    for(size_t s{0u}; s < stripes; ++s)
+    {
+        auto input = reinterpret_cast<const __m256i*>(data + s * STRIPE_SIZE);
+        auto key = reinterpret_cast<const __m256i*>(secret + s);
+        for(size_t i{0u}; i < 2u; ++i)
+        {
+            auto value = _mm256_loadu_si256(input + i);
+            auto keyed = _mm256_xor_si256(value, _mm256_loadu_si256(key + i));
+            auto product = _mm256_mul_epu32(keyed, _mm256_srli_epi64(keyed, 32));
+            auto swapped = _mm256_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+            lanes[i] = _mm256_add_epi64(lanes[i], _mm256_add_epi64(product, swapped));
+        }
+    }
+    for(size_t i{0u}; i < 2u; ++i)
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc) + i, lanes[i]);
+}
+
+#endif
+
+using AccumulateFunction = void (*)(uint64_t*, const char*, const uint64_t*, size_t);
+
+AccumulateFunction selectAccumulate()
+{
+#ifdef HASH_UTILS_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        return accumulateAvx2;
+    return accumulateSse2;
+#else
+    return accumulateScalar;
+#endif
+}
+
+//Keeps the high bits of the products flowing back into the low ones
+void scramble(uint64_t *acc)
+{
+    for(size_t lane{0u}; lane < 8u; ++lane)
+    {
+        auto value = acc[lane] ^ (acc[lane] >> 47) ^ SECRET.words[SCRAMBLE_SECRET + lane];
+        acc[lane] = value * SCRAMBLE_PRIME;
+    }
+}
+
+uint64_t hashLong(const char *data, size_t length, uint64_t seed)
+{
+    static const AccumulateFunction accumulate {selectAccumulate()};
+    uint64_t acc[8];
+    for(size_t lane{0u}; lane < 8u; ++lane)
+        acc[lane] = SECRET.words[lane] + seed;
+
+    constexpr auto blockSize = STRIPE_SIZE * STRIPES_PER_BLOCK;
+    //The last stripe is always hashed on its own, overlapping the previous one
+    auto blocks = (length - 1) / blockSize;
+    for(size_t b{0u}; b < blocks; ++b)
+    {
+        accumulate(acc, data + b * blockSize, SECRET.words, STRIPES_PER_BLOCK);
+        scramble(acc);
+    }
+    auto stripes = (length - 1 - blocks * blockSize) / STRIPE_SIZE;
+    accumulate(acc, data + blocks * blockSize, SECRET.words, stripes);
+    accumulate(acc, data + length - STRIPE_SIZE, SECRET.words + LAST_STRIPE_SECRET, 1u);
+
+    uint64_t hash {length * WY_P0 ^ seed};
+    for(size_t i{0u}; i < 4u; ++i)
+    {
+        hash += multiplyFold(acc[2 * i] ^ SECRET.words[MERGE_SECRET + 2 * i],
+                             acc[2 * i + 1] ^ SECRET.words[MERGE_SECRET + 2 * i + 1]);
+    }
+    return mix64(hash);
+}
+
+inline uint64_t rotateLeft(uint64_t value, int bits) noexcept
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+inline void sipRound(uint64_t &v0, uint64_t &v1, uint64_t &v2, uint64_t &v3) noexcept
+{
+    v0 += v1; v1 = rotateLeft(v1, 13); v1 ^= v0; v0 = rotateLeft(v0, 32);
+    v2 += v3; v3 = rotateLeft(v3, 16); v3 ^= v2;
+    v0 += v3; v3 = rotateLeft(v3, 21); v3 ^= v0;
+    v2 += v1; v1 = rotateLeft(v1, 17); v1 ^= v2; v2 = rotateLeft(v2, 32);
+}
+
+}
+
+uint64_t hash_string64(const char *data, size_t length, uint64_t seed)
+{
+    if(length > LONG_KEY_SIZE)
+        return hashLong(data, length, seed);
+
+    seed ^= multiplyFold(seed ^ WY_P0, WY_P1);
+    uint64_t a, b;
+    if(length <= 16)
+    {
+        if(length >= 4)
+        {
+            //Two pairs of possibly overlapping 4 byte words cover 4..16 bytes
+            auto offset = (length >> 3) << 2;
+            a = (read32(data) << 32) | read32(data + offset);
+            b = (read32(data + length - 4) << 32) | read32(data + length - 4 - offset);
+        }
+        else if(length > 0)
+        {
+            a = (uint64_t(static_cast<unsigned char>(data[0])) << 16) |
+                (uint64_t(static_cast<unsigned char>(data[length >> 1])) << 8) |
+                static_cast<unsigned char>(data[length - 1]);
+            b = 0;
+        }
+        else
+        {
+            a = b = 0;
+        }
+    }
+    else
+    {
+        auto remaining = length;
+        if(remaining > 48)
+        {
+            auto seed1 = seed, seed2 = seed;
+            do
+            {
+                seed = multiplyFold(read64(data) ^ WY_P1, read64(data + 8) ^ seed);
+                seed1 = multiplyFold(read64(data + 16) ^ WY_P2, read64(data + 24) ^ seed1);
+                seed2 = multiplyFold(read64(data + 32) ^ WY_P3, read64(data + 40) ^ seed2);
+                data += 48;
+                remaining -= 48;
+            } while(remaining > 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while(remaining > 16)
+        {
+            seed = multiplyFold(read64(data) ^ WY_P1, read64(data + 8) ^ seed);
+            data += 16;
+            remaining -= 16;
+        }
+        //The last 16 bytes of the key, which may overlap the ones already mixed
+        a = read64(data + remaining - 16);
+        b = read64(data + remaining - 8);
+    }
+    a ^= WY_P1;
+    b ^= seed;
+    multiply128(a, b);
+    return multiplyFold(a ^ WY_P0 ^ length, b ^ WY_P1);
+}
+
+uint64_t hash_siphash(const char *data, size_t length, uint64_t k0, uint64_t k1)
+{
+    uint64_t v0 {k0 ^ 0x736f6d6570736575ULL};
+    uint64_t v1 {k1 ^ 0x646f72616e646f6dULL};
+    uint64_t v2 {k0 ^ 0x6c7967656e657261ULL};
+    uint64_t v3 {k1 ^ 0x7465646279746573ULL};
+    auto compress = [&](uint64_t word)
+    {
+        v3 ^= word;
+        for(int i{0}; i < SIP_C_ROUNDS; ++i)
+            sipRound(v0, v1, v2, v3);
+        v0 ^= word;
+    };
+
+    auto end = data + (length & ~size_t(7));
+    for(; data != end; data += 8)
+        compress(read64(data));
+    //The last word holds the remaining bytes and the length in its top byte
+    uint64_t last {uint64_t(length) << 56};
+    for(size_t i{0u}; i < (length & 7); ++i)
+        last |= uint64_t(static_cast<unsigned char>(data[i])) << (8 * i);
+    compress(last);
+
+    v2 ^= 0xff;
+    for(int i{0}; i < SIP_D_ROUNDS; ++i)
+        sipRound(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+//One random base per process, each call steps a counter through mix64, which
+//is a bijection, so the seeds never repeat
+uint64_t makeHashSeed()
+{
+    static const uint64_t base = []
+    {
+        try
+        {
+            std::random_device device;
+            return (uint64_t(device()) << 32) ^ device();
+        }
+        catch(...)
+        {
+            return uint64_t(std::chrono::steady_clock::now().time_since_epoch().count());
+        }
+    }();
+    static std::atomic<uint64_t> counter {0u};
+    return mix64(base + HASH64_S * counter.fetch_add(1u, std::memory_order_relaxed));
+}
+
 size_t getGreatestCommonDivisor (size_t firstNumber, size_t secondNumber)
 {
     size_t x;
@@ -96,3 +418,19 @@ size_t getPrimeNumberGreaterThan(size_t number)
     } while(!isPrime(i));
     return i;
 }
+
+size_t getPrimeNumberNotLessThan(size_t number)
+{
+    auto i = std::max<size_t>(number, 3u) | 1u;
+    while(!isPrime(i))
+        i += 2;
+    return i;
+}
+
+size_t getPowerOfTwoNotLessThan(size_t number)
+{
+    size_t powerOfTwo {1};
+    while(powerOfTwo < number)
+        powerOfTwo <<= 1;
+    return powerOfTwo;
+}
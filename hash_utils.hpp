@@ -2,8 +2,11 @@
 #define HASH_UTILS_HPP
 
 #include <cstdlib>
+#include <cstdint>
 #include <string>
 #include <cmath>
+#include <functional>
+#include <type_traits>
 
 size_t hash1(int key, size_t max);
 
@@ -15,6 +18,25 @@ size_t hash_string2(const std::string &keyString, size_t hashSize);
 
 size_t hash_sedgwick(const std::string &keyString, size_t hashSize);
 
+//Full 64 bit hash of a byte string, in the family of wyhash and XXH3.
+//Keys up to 256 bytes are mixed 16 bytes per step (48 with three independent
+//lanes above 48 bytes) through 64x64->128 bit multiplies. Longer keys are
+//accumulated in 64 byte stripes over eight lanes, with AVX2 or SSE2 when the
+//CPU has them and plain code otherwise, all paths giving the same hash
+uint64_t hash_string64(const char *data, size_t length, uint64_t seed = 0u);
+
+inline uint64_t hash_string64(const std::string &key, uint64_t seed = 0u)
+{
+    return hash_string64(key.data(), key.size(), seed);
+}
+
+//SipHash-1-3 of a byte string under the 128 bit key (k0, k1): a keyed hash
+//whose collisions cannot be found without the key
+uint64_t hash_siphash(const char *data, size_t length, uint64_t k0, uint64_t k1);
+
+//Random value for seeding hashers, different on every call
+uint64_t makeHashSeed();
+
 size_t getGreatestCommonDivisor (size_t firstNumber, size_t secondNumber); //Euclid algorithm
 
 bool isPrime(size_t number);
@@ -23,4 +45,192 @@ bool isPrime2(size_t number);
 
 size_t getPrimeNumberGreaterThan(size_t number);
 
+size_t getPrimeNumberNotLessThan(size_t number);
+
+size_t getPowerOfTwoNotLessThan(size_t number);
+
+//2^64 / golden ratio, the 64 bit counterpart of HASH32_S
+constexpr uint64_t HASH64_S {11400714819323198485ULL};
+
+//Multiplicative (Fibonacci) reduction of a full hash to [0, tableSize),
+//tableSize must be a power of two greater than one
+inline size_t fibonacci_hash(uint64_t hash, size_t tableSize) noexcept
+{
+    return (hash * HASH64_S) >> (64 - __builtin_ctzll(tableSize));
+}
+
+//Finalizer of MurmurHash3, spreads every input bit over the whole word
+inline uint64_t mix64(uint64_t x) noexcept
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+//FNV-1a
+inline uint64_t hash_bytes(const char *data, size_t length) noexcept
+{
+    uint64_t hash {14695981039346656037ULL};
+    for(size_t i {0}; i < length; ++i)
+    {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+//Hint to start loading the cache line of address, a no-op for compilers
+//without the builtin. Prefetching never faults, even on a null pointer
+inline void prefetch(const void *address) noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address);
+#else
+    (void)address;
+#endif
+}
+
+//Hasher policies are called as hasher(key, max) and return an index in [0, max).
+//hash(key) gives the full unreduced hash.
+template<class K, class Enable = void>
+struct DefaultHasher
+{
+    inline size_t hash(const K &key) const noexcept { return mix64(std::hash<K>{}(key)); }
+    inline size_t operator()(const K &key, size_t max) const noexcept { return hash(key) % max; }
+};
+
+template<class K>
+struct DefaultHasher<K, std::enable_if_t<std::is_integral<K>::value>>
+{
+    inline size_t hash(const K &key) const noexcept { return mix64(static_cast<uint64_t>(key)); }
+    inline size_t operator()(const K &key, size_t max) const noexcept { return hash(key) % max; }
+};
+
+template<>
+struct DefaultHasher<std::string>
+{
+    inline size_t hash(const std::string &key) const noexcept
+    {
+        return hash_string64(key.data(), key.size());
+    }
+    inline size_t operator()(const std::string &key, size_t max) const noexcept
+    {
+        return hash(key) % max;
+    }
+};
+
+//Key of the seeded hashers, random unless given
+class HashSeed
+{
+public:
+    HashSeed(): HashSeed(makeHashSeed(), makeHashSeed()) {}
+    HashSeed(uint64_t k0, uint64_t k1): mK0{k0}, mK1{k1} {}
+protected:
+    uint64_t mK0, mK1;
+    //Two keyed rounds of mix64. Not a PRF like SipHash, but which values
+    //collide depends on the key
+    inline uint64_t mixSeeded(uint64_t value) const noexcept { return mix64(mix64(value ^ mK0) + mK1); }
+};
+
+//Hashers for tables fed with untrusted keys. Each default constructed
+//instance, so each table, draws its own random key, so no one can pick keys
+//that all land in one bucket. Copies of a table keep the key of the original.
+//Strings go through SipHash, other keys through seeded mixing.
+template<class K, class Enable = void>
+struct SeededHasher: HashSeed
+{
+    using HashSeed::HashSeed;
+    inline size_t hash(const K &key) const noexcept { return mixSeeded(std::hash<K>{}(key)); }
+    inline size_t operator()(const K &key, size_t max) const noexcept { return hash(key) % max; }
+};
+
+template<class K>
+struct SeededHasher<K, std::enable_if_t<std::is_integral<K>::value>>: HashSeed
+{
+    using HashSeed::HashSeed;
+    inline size_t hash(const K &key) const noexcept { return mixSeeded(static_cast<uint64_t>(key)); }
+    inline size_t operator()(const K &key, size_t max) const noexcept { return hash(key) % max; }
+};
+
+template<>
+struct SeededHasher<std::string>: HashSeed
+{
+    using HashSeed::HashSeed;
+    inline size_t hash(const std::string &key) const noexcept
+    {
+        return hash_siphash(key.data(), key.size(), mK0, mK1);
+    }
+    inline size_t operator()(const std::string &key, size_t max) const noexcept
+    {
+        return hash(key) % max;
+    }
+};
+
+//Step of double hashing, never zero so the probe sequence always moves
+template<class K>
+struct DefaultStepHasher
+{
+    inline size_t hash(const K &key) const noexcept { return mHasher.hash(key) >> 32; }
+    inline size_t operator()(const K &key, size_t max) const noexcept
+    {
+        if(max < 2) return 1;
+        return 1 + hash(key) % (max - 1);
+    }
+private:
+    DefaultHasher<K> mHasher;
+};
+
+//Step of double hashing for the tables that use SeededHasher, keyed too since
+//an unseeded step lets colliding keys be picked to share their probe sequence.
+//Default constructed it draws its own key, built from a SeededHasher it takes
+//the key of that hasher
+template<class K>
+struct SeededStepHasher
+{
+    SeededStepHasher() = default;
+    explicit SeededStepHasher(const SeededHasher<K> &hasher): mHasher{hasher} {}
+    inline size_t hash(const K &key) const noexcept { return mHasher.hash(key) >> 32; }
+    inline size_t operator()(const K &key, size_t max) const noexcept
+    {
+        if(max < 2) return 1;
+        return 1 + hash(key) % (max - 1);
+    }
+private:
+    SeededHasher<K> mHasher;
+};
+
+//Adapter for the callers that select the hash function at runtime
+template<class K>
+class FunctionHasher
+{
+public:
+    template<class F, class = std::enable_if_t<std::is_invocable_r<size_t, F, const K&, size_t>::value>>
+    FunctionHasher(F function): mFunction(std::move(function)) {}
+    inline size_t operator()(const K &key, size_t max) const { return mFunction(key, max); }
+private:
+    std::function<size_t(const K &key, size_t max)> mFunction;
+};
+
+//Full unreduced hash of a key: hasher.hash(key) when the hasher has it,
+//otherwise the hasher is asked for an index below SIZE_MAX
+template<class Hasher, class K, class = void>
+struct HasFullHash: std::false_type {};
+
+template<class Hasher, class K>
+struct HasFullHash<Hasher, K,
+        std::void_t<decltype(std::declval<const Hasher&>().hash(std::declval<const K&>()))>>:
+        std::true_type {};
+
+template<class Hasher, class K>
+inline size_t fullHash(const Hasher &hasher, const K &key)
+{
+    if constexpr(HasFullHash<Hasher, K>::value)
+        return hasher.hash(key);
+    else
+        return hasher(key, SIZE_MAX);
+}
+
 #endif // HASH_UTILS_HPP
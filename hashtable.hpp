@@ -2,11 +2,23 @@
 #define HASHTABLE_HPP
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
 #include <functional>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include "array_list.hpp"
 #include "singly_linked_list.hpp"
 #include "hash_utils.hpp"
+#include "occupancy_bitmap.hpp"
+#include "table_stats.hpp"
 
 
 
@@ -14,15 +26,19 @@ template<class K, class V>
 class Map
 {
 public:
+    using key_type = K;
+    using mapped_type = V;
+
     explicit Map() = default;
     Map(const Map<K,V> &other) = default;
     Map(Map<K,V> &&other) = default;
     Map<K,V>& operator=(const Map<K,V> &rhs) = default;
     Map<K,V>& operator=(Map<K,V> &&rhs) = default;
     virtual ~Map() {}
-    inline auto count() const noexcept { return mCount; }
-    inline auto isEmpty() const noexcept { return mCount == 0; }
+    virtual size_t count() const noexcept { return mCount; }
+    inline bool isEmpty() const noexcept { return count() == 0; }
     virtual void insert(const K &key, const V &value) = 0;
+    virtual void insert(K &&key, V &&value) = 0;
     virtual void update(const K &key, const V &value) = 0;
     virtual void remove(const K &key) = 0;
     virtual bool find(const K &key, V &value) const = 0;
@@ -32,6 +48,28 @@ protected:
     int test {0};
 };
 
+//Compile time counterpart of Map: T is map-like when it has the operations
+//of Map<T::key_type, T::mapped_type>, whether it derives from it or not.
+//The engines are final, so generic code templated on the engine type calls
+//them without virtual dispatch and gets their probe loops inlined
+template<class T, class = void>
+struct IsMapLike: std::false_type {};
+
+template<class T>
+struct IsMapLike<T, std::void_t<
+        decltype(size_t(std::declval<const T&>().count())),
+        decltype(std::declval<T&>().insert(std::declval<const typename T::key_type&>(),
+                                           std::declval<const typename T::mapped_type&>())),
+        decltype(std::declval<T&>().update(std::declval<const typename T::key_type&>(),
+                                           std::declval<const typename T::mapped_type&>())),
+        decltype(std::declval<T&>().remove(std::declval<const typename T::key_type&>())),
+        decltype(typename T::mapped_type(std::declval<const T&>().get(
+                     std::declval<const typename T::key_type&>()))),
+        std::enable_if_t<std::is_same<bool, decltype(std::declval<const T&>().find(
+                     std::declval<const typename T::key_type&>(),
+                     std::declval<typename T::mapped_type&>()))>::value>>>:
+        std::true_type {};
+
 template<class K, class V>
 struct Pair
 {
@@ -39,109 +77,657 @@ struct Pair
     V value;
 };
 
-template<class K, class V>
-class HashTable: public Map<K,V>
+//Stands for a V built from the stored arguments. Used as the initializer of
+//the value member of an aggregate, it constructs the value right in place
+//even from several constructor arguments.
+template<class V, class... Args>
+struct InPlaceValue
+{
+    std::tuple<Args&&...> args;
+    operator V() { return std::make_from_tuple<V>(std::move(args)); }
+};
+
+template<class V, class... Args>
+inline InPlaceValue<V, Args...> makeInPlaceValue(Args&&... args)
+{
+    return {std::forward_as_tuple(std::forward<Args>(args)...)};
+}
+
+//IMMEDIATE moves every item into the resized table at once. INCREMENTAL keeps
+//the old and the new storage side by side and migrates a bounded part of the
+//old one on every modifying operation, lookups consult both until it is done.
+enum class ResizePolicy
+{
+    IMMEDIATE,
+    INCREMENTAL
+};
+
+//PRIME sizes the storage with prime numbers and lets the hasher reduce keys
+//with %, which tolerates weak hash functions. POWER_OF_TWO takes the full hash
+//and reduces it with a multiply-shift, so probing needs no division at all.
+enum class CapacityMode
+{
+    PRIME,
+    POWER_OF_TWO
+};
+
+//Calls f(t) for t in [0, threadsNumber), the calling thread takes t = 0
+template<class F>
+void runInThreads(size_t threadsNumber, F &&f)
+{
+    std::vector<std::thread> workers;
+    for(size_t t{1u}; t < threadsNumber; ++t)
+        workers.emplace_back(f, t);
+    f(0u);
+    for(auto &worker : workers)
+        worker.join();
+}
+
+//Input of a bulk build radix-partitioned by home slot (bucket): the slots are
+//cut into regions small enough to stay in cache while they are filled, and
+//the input positions are grouped by the region of their home, keeping the
+//input order inside a region. Each region can then be filled by one thread
+//without locks.
+class BulkBuildPlan
+{
+public:
+    struct Entry
+    {
+        size_t index;       //Position in the input
+        size_t home;
+    };
+
+    //homeOf(key) gives the home slot of a key among tableSize slots
+    template<class It, class HomeOf>
+    BulkBuildPlan(It begin, size_t count, size_t tableSize, size_t slotSize,
+                  size_t threadsNumber, const HomeOf &homeOf);
+    inline size_t partitionCount() const noexcept { return mPartitions; }
+    //Regions are [regionBegin(p), regionBegin(p + 1))
+    inline size_t regionBegin(size_t partition) const noexcept
+    {
+        return std::min(partition * mRegionSize, mTableSize);
+    }
+    inline const Entry* begin(size_t partition) const noexcept { return mEntries.data() + mOffsets[partition]; }
+    inline const Entry* end(size_t partition) const noexcept { return mEntries.data() + mOffsets[partition + 1]; }
+    //Calls f(partition) for every partition, spread over the threads
+    template<class F>
+    void forEachPartition(F &&f) const;
+private:
+    static constexpr size_t REGION_BYTES {256u * 1024u};
+    size_t mTableSize;
+    size_t mThreadsNumber;
+    size_t mRegionSize;
+    size_t mPartitions;
+    std::vector<size_t> mOffsets;
+    std::vector<Entry> mEntries;
+    inline size_t partitionOf(size_t home) const noexcept { return home / mRegionSize; }
+    static inline size_t roundToBitmapWords(size_t slots) noexcept
+    {
+        constexpr auto bits = OccupancyBitmap::WORD_BITS;
+        return std::max<size_t>(bits, (slots + bits - 1) / bits * bits);
+    }
+};
+
+//Key of an input item of a bulk build, which is an std::pair or a Pair
+template<class Item>
+inline const auto& bulkKey(const Item &item)
+{
+    const auto &[key, value] = item;
+    (void)value;
+    return key;
+}
+
+template<class It, class HomeOf>
+BulkBuildPlan::BulkBuildPlan(It begin, size_t count, size_t tableSize, size_t slotSize,
+                             size_t threadsNumber, const HomeOf &homeOf):
+    mTableSize{tableSize},
+    mThreadsNumber{std::max<size_t>(1u, std::min<size_t>(threadsNumber ? threadsNumber :
+                                                             std::thread::hardware_concurrency(),
+                                                         count / 1024u + 1))},
+    //At least 16 regions per thread for balance, at most REGION_BYTES each,
+    //in whole words of the occupancy bitmap so threads never share a word
+    mRegionSize{roundToBitmapWords(std::min(tableSize / (16 * mThreadsNumber),
+                                            REGION_BYTES / std::max<size_t>(slotSize, 1u)))},
+    mPartitions{(tableSize + mRegionSize - 1) / mRegionSize},
+    mOffsets(mPartitions + 1),
+    mEntries(count)
+{
+    //The threads hash their chunk of the input and count it per partition,
+    //then scatter it to the slice of each partition set aside for them
+    std::vector<size_t> homes(count);
+    std::vector<std::vector<size_t>> counts(mThreadsNumber, std::vector<size_t>(mPartitions));
+    auto chunkBegin = [&](size_t t) { return t * count / mThreadsNumber; };
+    runInThreads(mThreadsNumber, [&](size_t t)
+    {
+        auto it = std::next(begin, chunkBegin(t));
+        for(size_t i{chunkBegin(t)}; i < chunkBegin(t + 1); ++i, ++it)
+        {
+            homes[i] = homeOf(bulkKey(*it));
+            ++counts[t][partitionOf(homes[i])];
+        }
+    });
+    size_t offset {0u};
+    for(size_t p{0u}; p < mPartitions; ++p)
+    {
+        mOffsets[p] = offset;
+        for(size_t t{0u}; t < mThreadsNumber; ++t)
+        {
+            auto partitionCount = counts[t][p];
+            counts[t][p] = offset;
+            offset += partitionCount;
+        }
+    }
+    mOffsets[mPartitions] = offset;
+    runInThreads(mThreadsNumber, [&](size_t t)
+    {
+        for(size_t i{chunkBegin(t)}; i < chunkBegin(t + 1); ++i)
+            mEntries[counts[t][partitionOf(homes[i])]++] = {i, homes[i]};
+    });
+}
+
+template<class F>
+void BulkBuildPlan::forEachPartition(F &&f) const
+{
+    std::atomic<size_t> next {0u};
+    runInThreads(mThreadsNumber, [&](size_t)
+    {
+        for(auto p = next.fetch_add(1u); p < mPartitions; p = next.fetch_add(1u))
+            f(p);
+    });
+}
+
+template<class K, class V, class Hasher = DefaultHasher<K>, class KeyEqual = std::equal_to<K>>
+class HashTable final: public Map<K,V>
 {
 public:
-    explicit HashTable(size_t bucketsNumber,
-                       std::function<size_t(const K &key, size_t max)> hf);
-    HashTable(const HashTable<K,V> &other) = default;
-    HashTable(HashTable<K,V> &&other) = default;
-    HashTable<K,V>& operator=(const HashTable<K,V> &rhs) = default;
-    HashTable<K,V>& operator=(HashTable<K,V> &&rhs) = default;
-    virtual ~HashTable() = default;
+    explicit HashTable(size_t bucketsNumber, const Hasher &hf = Hasher(),
+                       const KeyEqual &keyEqual = KeyEqual());
+    HashTable(const HashTable<K,V,Hasher,KeyEqual> &other);
+    HashTable(HashTable<K,V,Hasher,KeyEqual> &&other) = default;
+    HashTable<K,V,Hasher,KeyEqual>& operator=(const HashTable<K,V,Hasher,KeyEqual> &rhs);
+    HashTable<K,V,Hasher,KeyEqual>& operator=(HashTable<K,V,Hasher,KeyEqual> &&rhs) = default;
+    virtual ~HashTable();
     virtual void insert(const K &key, const V &value) override;
+    virtual void insert(K &&key, V &&value) override;
+    //Builds the value in place from args when the key is absent, otherwise
+    //leaves the table and the arguments untouched. Returns true on insertion
+    template<class... Args>
+    bool try_emplace(const K &key, Args&&... args);
+    template<class... Args>
+    bool try_emplace(K &&key, Args&&... args);
+    //Same as try_emplace
+    template<class... Args>
+    bool emplace(const K &key, Args&&... args);
+    template<class... Args>
+    bool emplace(K &&key, Args&&... args);
+    //Assigns the value of an existing key without touching the key
+    template<class M>
+    bool insert_or_assign(const K &key, M &&value);
+    template<class M>
+    bool insert_or_assign(K &&key, M &&value);
     virtual void update(const K &key, const V &value) override;
+    void update(const K &key, V &&value);
     virtual void remove(const K &key) override;
     virtual bool find(const K &key, V &value) const override;
     virtual const V get(const K &key) const override;
+    //Batched operations hash keys ahead of the one being resolved and prefetch
+    //their buckets, so the cache misses of a batch overlap
+    void findBatch(const K *keys, size_t n, V *out, bool *found) const;
+    void insertBatch(const K *keys, const V *values, size_t n);
+    void removeBatch(const K *keys, size_t n);
+    //Replaces the content with the (key, value) pairs of the random access
+    //range [begin, end), a later duplicate key overriding an earlier one. The
+    //buckets are sized once and filled by threadsNumber threads (0 means one
+    //per hardware thread), each linking the nodes of its own bucket regions
+    template<class It>
+    void bulkBuild(It begin, It end, size_t threadsNumber = 0u);
+    template<bool IsConst>
+    class Iterator;
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+    //Forward iteration in bucket order. During a migration the buckets not
+    //migrated yet come last. Any modification of the table invalidates the
+    //iterators, and keys must not be changed through them
+    iterator begin();
+    inline iterator end() noexcept { return iterator(); }
+    const_iterator begin() const;
+    inline const_iterator end() const noexcept { return const_iterator(); }
+    inline const_iterator cbegin() const { return begin(); }
+    inline const_iterator cend() const noexcept { return end(); }
     void clear();
     const V operator[](const K &key) const;
     V& operator[](const K &key);
     virtual void print() const;
+    inline size_t bucketCount() const noexcept { return mBuckets.size(); }
+    inline float loadFactor() const noexcept { return float(mCount) / mBuckets.size(); }
+    inline float maxLoadFactor() const noexcept { return mMaxLoadFactor; }
+    inline float minLoadFactor() const noexcept { return mMinLoadFactor; }
+    void setMaxLoadFactor(float maxLoadFactor);
+    //Shrinking is disabled while the min load factor is zero (the default)
+    void setMinLoadFactor(float minLoadFactor);
+    void reserve(size_t count);
+    void rehash(size_t bucketsNumber);
+    inline ResizePolicy resizePolicy() const noexcept { return mResizePolicy; }
+    inline void setResizePolicy(ResizePolicy policy) noexcept { mResizePolicy = policy; }
+    inline bool isMigrating() const noexcept { return mOldBuckets.size() > 0; }
+    void finishMigration();
+    inline CapacityMode capacityMode() const noexcept { return mCapacityMode; }
+    void setCapacityMode(CapacityMode mode);
+    //Chain lengths and hash skew of the current buckets plus the resize and
+    //collision counters, see TableStats
+    TableStats stats() const;
 protected:
     using Map<K,V>::mCount;
 private:
+    using Buckets = Array<LinkedList<Pair<K,V>>>;
+    static constexpr size_t MIGRATION_STEP {8u};     //Old buckets relinked per operation
+    static constexpr size_t PREFETCH_DISTANCE {16u}; //Keys looked ahead by the batches
 
-    Array<LinkedList<Pair<K,V>>> mBuckets;
-    std::function<size_t(const K &key, size_t max)> mHashFunction;
-    auto findPosition(const K &key) const;
-    template<class Key, class Value>
+    Buckets mBuckets;
+    Hasher mHashFunction;
+    KeyEqual mKeyEqual;
+    float mMaxLoadFactor {1.0f};
+    float mMinLoadFactor {0.0f};
+    size_t mMinBucketsNumber {0u};
+    ResizePolicy mResizePolicy {ResizePolicy::IMMEDIATE};
+    Buckets mOldBuckets {0u};
+    size_t mMigrationIndex {0u};
+    //Non-empty buckets of mBuckets and mOldBuckets
+    OccupancyBitmap mOccupied;
+    OccupancyBitmap mOldOccupied;
+    CapacityMode mCapacityMode {CapacityMode::PRIME};
+    StatsCounters mCounters;
+    //Declared last: on move assignment the old nodes must go back to the old
+    //pool before it is replaced
+    std::unique_ptr<NodePool<Pair<K,V>>> mPool;
+    void initBuckets(Buckets &buckets);
+    inline OccupancyBitmap& occupancyOf(const Buckets &buckets) noexcept
+    {
+        return &buckets == &mBuckets ? mOccupied : mOldOccupied;
+    }
+    inline size_t bucketIndex(const K &key, size_t bucketsNumber) const;
+    inline size_t roundBucketsNumber(size_t bucketsNumber) const;
+    auto findPosition(const Buckets &buckets, const K &key) const;
+    Node<Pair<K,V>>* findInBucket(const LinkedList<Pair<K,V>> &bucket, const K &key) const;
+    Node<Pair<K,V>>* findNode(const K &key) const;
+    template<class KeyArg, class... Args>
+    std::pair<Node<Pair<K,V>>*, bool> tryEmplaceNode(KeyArg &&key, Args&&... args);
+    bool removeFrom(Buckets &buckets, const K &key);
+    void linkNode(Buckets &buckets, Node<Pair<K,V>> *node);
+    void migrateBuckets(size_t bucketsNumber);
+    template<class Key, class Value, class H, class E>
     friend class HashTableIterator;
 };
 
-template<class K, class V>
-HashTable<K,V>::HashTable(size_t bucketsNumber,
-                          std::function<size_t(const K &, size_t max)> hf):
-    Map<K,V>::Map(),mBuckets(getPrimeNumberGreaterThan(bucketsNumber)), mHashFunction(hf)
+template<class K, class V, class Hasher, class KeyEqual>
+HashTable<K,V,Hasher,KeyEqual>::HashTable(size_t bucketsNumber, const Hasher &hf,
+                                          const KeyEqual &keyEqual):
+    Map<K,V>::Map(),mBuckets(getPrimeNumberGreaterThan(bucketsNumber)), mHashFunction(hf),
+    mKeyEqual(keyEqual), mPool(new NodePool<Pair<K,V>>())
 {
-    for(size_t i{0u}; i < mBuckets.capacity(); ++i)
-        mBuckets.add(LinkedList<Pair<K,V>>());
+    initBuckets(mBuckets);
+    mOccupied = OccupancyBitmap(mBuckets.size());
+    mMinBucketsNumber = bucketsNumber;
 }
 
-template<class K, class V>
-void HashTable<K,V>::insert(const K &key, const V &value)
+template<class K, class V, class Hasher, class KeyEqual>
+HashTable<K,V,Hasher,KeyEqual>::HashTable(const HashTable<K,V,Hasher,KeyEqual> &other):
+    Map<K,V>::Map(), mBuckets(other.mBuckets.size()), mHashFunction(other.mHashFunction),
+    mKeyEqual(other.mKeyEqual), mMaxLoadFactor(other.mMaxLoadFactor),
+    mMinLoadFactor(other.mMinLoadFactor), mMinBucketsNumber(other.mMinBucketsNumber),
+    mResizePolicy(other.mResizePolicy), mCapacityMode(other.mCapacityMode),
+    mPool(new NodePool<Pair<K,V>>())
+{
+    initBuckets(mBuckets);
+    mOccupied = OccupancyBitmap(mBuckets.size());
+    for(size_t i{0u}; i < mBuckets.size(); ++i)
+    {
+        mBuckets[i].copyList(other.mBuckets[i]);
+        mCount += mBuckets[i].count();
+        if(!mBuckets[i].isEmpty())
+            mOccupied.set(i);
+    }
+    for(size_t i{other.mMigrationIndex}; i < other.mOldBuckets.size(); ++i)
+    {
+        for(auto it = other.mOldBuckets[i].head(); it != nullptr; it = it->next())
+            insert(it->data().key, it->data().value);
+    }
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+HashTable<K,V,Hasher,KeyEqual>& HashTable<K,V,Hasher,KeyEqual>::operator=(
+        const HashTable<K,V,Hasher,KeyEqual> &rhs)
+{
+    if(this == &rhs) return *this;
+    HashTable<K,V,Hasher,KeyEqual> copy(rhs);
+    return *this = std::move(copy);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+HashTable<K,V,Hasher,KeyEqual>::~HashTable()
+{
+    clear();
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void HashTable<K,V,Hasher,KeyEqual>::initBuckets(Buckets &buckets)
+{
+    for(size_t i{buckets.size()}; i < buckets.capacity(); ++i)
+        buckets.emplace_back();
+    for(size_t i{0u}; i < buckets.size(); ++i)
+        buckets[i].setPool(mPool.get());
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void HashTable<K,V,Hasher,KeyEqual>::insert(const K &key, const V &value)
+{
+    insert_or_assign(key, value);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void HashTable<K,V,Hasher,KeyEqual>::insert(K &&key, V &&value)
+{
+    insert_or_assign(std::move(key), std::move(value));
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<class... Args>
+bool HashTable<K,V,Hasher,KeyEqual>::try_emplace(const K &key, Args&&... args)
+{
+    return tryEmplaceNode(key, std::forward<Args>(args)...).second;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<class... Args>
+bool HashTable<K,V,Hasher,KeyEqual>::try_emplace(K &&key, Args&&... args)
+{
+    return tryEmplaceNode(std::move(key), std::forward<Args>(args)...).second;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<class... Args>
+bool HashTable<K,V,Hasher,KeyEqual>::emplace(const K &key, Args&&... args)
 {
-    auto hash = mHashFunction(key, mBuckets.capacity());
+    return tryEmplaceNode(key, std::forward<Args>(args)...).second;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<class... Args>
+bool HashTable<K,V,Hasher,KeyEqual>::emplace(K &&key, Args&&... args)
+{
+    return tryEmplaceNode(std::move(key), std::forward<Args>(args)...).second;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<class M>
+bool HashTable<K,V,Hasher,KeyEqual>::insert_or_assign(const K &key, M &&value)
+{
+    auto [node, isInserted] = tryEmplaceNode(key, std::forward<M>(value));
+    if(!isInserted)
+        node->data().value = std::forward<M>(value);
+    return isInserted;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<class M>
+bool HashTable<K,V,Hasher,KeyEqual>::insert_or_assign(K &&key, M &&value)
+{
+    auto [node, isInserted] = tryEmplaceNode(std::move(key), std::forward<M>(value));
+    if(!isInserted)
+        node->data().value = std::forward<M>(value);
+    return isInserted;
+}
+
+//Finds the node of the key or creates it with the value built from args.
+//The arguments are only consumed when a node is created, and the node stays
+//where it is through a rehash since rehashing relinks nodes.
+template<class K, class V, class Hasher, class KeyEqual>
+template<class KeyArg, class... Args>
+std::pair<Node<Pair<K,V>>*, bool> HashTable<K,V,Hasher,KeyEqual>::tryEmplaceNode(
+        KeyArg &&key, Args&&... args)
+{
+    if(isMigrating())
+        migrateBuckets(MIGRATION_STEP);
+    if(isMigrating())
+    {
+        auto node = findPosition(mOldBuckets, key);
+        if(node && mKeyEqual(node->data().key, key))
+            return {node, false};
+    }
+
+    auto hash = bucketIndex(key, mBuckets.capacity());
     LinkedList<Pair<K,V>> &bucket = mBuckets[hash];
-    Pair<K,V> pair = {key, value};
+    Node<Pair<K,V>> *node {nullptr};
 
-    if(bucket.isEmpty())
+    if(bucket.isEmpty() || key < bucket.head()->data().key)
+    {
+        node = bucket.emplaceFront(std::forward<KeyArg>(key),
+                                   makeInPlaceValue<V>(std::forward<Args>(args)...));
+    }
+    else if(mKeyEqual(key, bucket.head()->data().key))
     {
-        bucket.pushFront(pair);
-        ++mCount;
+        return {bucket.head(), false};
     }
     else
     {
         auto it = bucket.head();
         auto prev = it;
-        if(key <= it->data().key)
+        while(it && key > it->data().key)
         {
-            if(key == it->data().key)
-            {
-                bucket.updateAt(it, pair);
-            }
-            else
-            {
-                bucket.pushFront(pair);
-                ++mCount;
-            }
+            prev = it;
+            it = it->next();
         }
-        else
-        {
-            while(it && key > it->data().key)
-            {
-                prev = it;
-                it = it->next();
-            }
 
-            if(it && it != prev && prev->data().key == it->data().key) //If the list already have item with such key
-                bucket.updateAt(it, pair);         //we will update corresponding value
-            else
-            {
-                bucket.insertAt(prev, pair);       //otherwise we will insert the new key-value pair
-                ++mCount;
-            }
+        if(it && mKeyEqual(it->data().key, key))        //If the list already have item with such key
+            return {it, false};                          //we will hand it back
+        node = bucket.emplaceAt(prev, std::forward<KeyArg>(key),  //otherwise we will insert the new key-value pair
+                                makeInPlaceValue<V>(std::forward<Args>(args)...));
+    }
+    mOccupied.set(hash);
+    mCounters.addCollisions(bucket.count() > 1);
+    ++mCount;
+
+    if(loadFactor() > mMaxLoadFactor)
+        rehash(2 * mBuckets.size());
+    return {node, true};
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void HashTable<K,V,Hasher,KeyEqual>::setMaxLoadFactor(float maxLoadFactor)
+{
+    if(maxLoadFactor <= 0.0f) return;
+    mMaxLoadFactor = maxLoadFactor;
+    if(mMinLoadFactor * 2 > mMaxLoadFactor)
+        mMinLoadFactor = mMaxLoadFactor / 2;
+    if(loadFactor() > mMaxLoadFactor)
+        rehash(mBuckets.size());
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void HashTable<K,V,Hasher,KeyEqual>::setMinLoadFactor(float minLoadFactor)
+{
+    //Keeping min below half of max prevents grow/shrink ping-pong
+    mMinLoadFactor = std::max(0.0f, std::min(minLoadFactor, mMaxLoadFactor / 2));
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void HashTable<K,V,Hasher,KeyEqual>::reserve(size_t count)
+{
+    rehash(size_t(std::ceil(count / mMaxLoadFactor)));
+}
+
+//Relinks the existing nodes into a new bucket array, no node is reallocated or copied
+template<class K, class V, class Hasher, class KeyEqual>
+void HashTable<K,V,Hasher,KeyEqual>::rehash(size_t bucketsNumber)
+{
+    auto required = size_t(std::ceil(mCount / mMaxLoadFactor));
+    auto newBucketsNumber = roundBucketsNumber(std::max(bucketsNumber, required));
+    if(newBucketsNumber == mBuckets.size()) return;
+
+    [[maybe_unused]] auto timer = mCounters.timeResize();
+    finishMigration();
+    Buckets newBuckets(newBucketsNumber);
+    initBuckets(newBuckets);
+    mOldBuckets = std::move(mBuckets);
+    mBuckets = std::move(newBuckets);
+    mOldOccupied = std::move(mOccupied);
+    mOccupied = OccupancyBitmap(newBucketsNumber);
+    mMigrationIndex = 0;
+    if(mResizePolicy == ResizePolicy::IMMEDIATE)
+        finishMigration();
+    else
+        migrateBuckets(MIGRATION_STEP);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void HashTable<K,V,Hasher,KeyEqual>::setCapacityMode(CapacityMode mode)
+{
+    if(mode == mCapacityMode) return;
+    finishMigration();
+    mCapacityMode = mode;
+    //Prime and power of two sizes never coincide, so every node gets relinked.
+    //The old buckets were laid out with the other reduction and cannot be
+    //searched incrementally
+    auto policy = mResizePolicy;
+    mResizePolicy = ResizePolicy::IMMEDIATE;
+    rehash(mBuckets.size());
+    mResizePolicy = policy;
+}
+
+//A node at position i of its chain takes i lookup steps. During a migration
+//both bucket arrays are measured, each against its own size
+template<class K, class V, class Hasher, class KeyEqual>
+TableStats HashTable<K,V,Hasher,KeyEqual>::stats() const
+{
+    TableStats stats;
+    double squares {0.0}, expectedSquares {0.0};
+    auto scan = [&](const Buckets &buckets, size_t first)
+    {
+        size_t items {0u};
+        for(size_t i{first}; i < buckets.size(); ++i)
+        {
+            size_t length {0u};
+            for(auto it = buckets[i].head(); it != nullptr; it = it->next())
+                stats.addProbeLength(++length);
+            stats.maxChainLength = std::max(stats.maxChainLength, length);
+            squares += double(length) * length;
+            items += length;
         }
+        if(buckets.size() > first)
+            expectedSquares += items + double(items) * (items - 1) / (buckets.size() - first);
+    };
+    scan(mBuckets, 0u);
+    if(isMigrating())
+        scan(mOldBuckets, mMigrationIndex);
+    if(mCount)
+    {
+        stats.averageProbeLength /= mCount;
+        stats.skew = squares / expectedSquares;
     }
+    mCounters.copyTo(stats);
+    return stats;
 }
 
-template<class K, class V>
-auto HashTable<K,V>::findPosition(const K &key) const
+template<class K, class V, class Hasher, class KeyEqual>
+inline size_t HashTable<K,V,Hasher,KeyEqual>::bucketIndex(const K &key,
+                                                          size_t bucketsNumber) const
+{
+    if(mCapacityMode == CapacityMode::POWER_OF_TWO)
+        return fibonacci_hash(fullHash(mHashFunction, key), bucketsNumber);
+    return mHashFunction(key, bucketsNumber);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+inline size_t HashTable<K,V,Hasher,KeyEqual>::roundBucketsNumber(size_t bucketsNumber) const
+{
+    if(mCapacityMode == CapacityMode::POWER_OF_TWO)
+        return getPowerOfTwoNotLessThan(std::max<size_t>(bucketsNumber, 2u));
+    return getPrimeNumberNotLessThan(bucketsNumber);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void HashTable<K,V,Hasher,KeyEqual>::finishMigration()
+{
+    if(isMigrating())
+        migrateBuckets(mOldBuckets.size());
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void HashTable<K,V,Hasher,KeyEqual>::migrateBuckets(size_t bucketsNumber)
+{
+    auto last = std::min(mMigrationIndex + bucketsNumber, mOldBuckets.size());
+    for(; mMigrationIndex < last; ++mMigrationIndex)
+    {
+        while(auto node = mOldBuckets[mMigrationIndex].releaseFront())
+            linkNode(mBuckets, node);
+        mOldOccupied.reset(mMigrationIndex);
+    }
+    if(mMigrationIndex == mOldBuckets.size())
+    {
+        mOldBuckets = Buckets(0u);
+        mOldOccupied = OccupancyBitmap();
+        mMigrationIndex = 0;
+    }
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void HashTable<K,V,Hasher,KeyEqual>::linkNode(Buckets &buckets, Node<Pair<K,V>> *node)
+{
+    const K &key = node->data().key;
+    auto index = bucketIndex(key, buckets.size());
+    LinkedList<Pair<K,V>> &bucket = buckets[index];
+    occupancyOf(buckets).set(index);
+    if(bucket.isEmpty() || key < bucket.head()->data().key)
+    {
+        bucket.pushFrontNode(node);
+        return;
+    }
+    auto prev = bucket.head();
+    while(prev->next() && prev->next()->data().key < key)
+        prev = prev->next();
+    bucket.insertNodeAt(prev, node);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+auto HashTable<K,V,Hasher,KeyEqual>::findPosition(const Buckets &buckets, const K &key) const
 {
-    auto hash = mHashFunction(key, mBuckets.capacity());
-    const LinkedList<Pair<K,V>> &bucket = mBuckets[hash];
+    auto hash = bucketIndex(key, buckets.capacity());
+    const LinkedList<Pair<K,V>> &bucket = buckets[hash];
     auto it = bucket.head();
     while(it && key > it->data().key)
         it = it->next();
     return it;
 }
 
-template<class K, class V>
-bool HashTable<K,V>::find(const K &key, V &value) const
+template<class K, class V, class Hasher, class KeyEqual>
+Node<Pair<K,V>>* HashTable<K,V,Hasher,KeyEqual>::findInBucket(const LinkedList<Pair<K,V>> &bucket,
+                                                               const K &key) const
+{
+    auto it = bucket.head();
+    while(it && key > it->data().key)
+        it = it->next();
+    return it && mKeyEqual(it->data().key, key) ? it : nullptr;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+Node<Pair<K,V>>* HashTable<K,V,Hasher,KeyEqual>::findNode(const K &key) const
+{
+    auto it = findPosition(mBuckets, key);
+    if(it && mKeyEqual(it->data().key, key))
+        return it;
+    if(isMigrating())
+    {
+        it = findPosition(mOldBuckets, key);
+        if(it && mKeyEqual(it->data().key, key))
+            return it;
+    }
+    return nullptr;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+bool HashTable<K,V,Hasher,KeyEqual>::find(const K &key, V &value) const
 {
-    auto it = findPosition(key);
-    if(it && it->data().key == key)
+    if(auto it = findNode(key))
     {
         value = it->data().value;
         return true;
@@ -149,72 +735,237 @@ bool HashTable<K,V>::find(const K &key, V &value) const
     return false;
 }
 
-template<class K, class V>
-void HashTable<K,V>::update(const K &key, const V &value)
+//Three stage pipeline: the bucket of key i + PREFETCH_DISTANCE is fetched,
+//the head node of key i + PREFETCH_DISTANCE / 2 whose bucket has arrived by
+//then is fetched, and key i is resolved. During a migration a key may live
+//in either bucket array, so the batch falls back to find()
+template<class K, class V, class Hasher, class KeyEqual>
+void HashTable<K,V,Hasher,KeyEqual>::findBatch(const K *keys, size_t n, V *out,
+                                               bool *found) const
 {
-    auto hash = mHashFunction(key, mBuckets.capacity());
-    LinkedList<Pair<K,V>> &bucket = mBuckets[hash];
-    auto it = bucket.head();
-    while(it && key > it->data().key)
-        it = it->next();
-    //auto it = findPosition(key);
-    if(it && it->data().key == key)
+    if(isMigrating())
+    {
+        for(size_t i{0u}; i < n; ++i)
+            found[i] = find(keys[i], out[i]);
+        return;
+    }
+    size_t indices[PREFETCH_DISTANCE];
+    auto prefetchBucket = [&](size_t i)
+    {
+        auto index = bucketIndex(keys[i], mBuckets.size());
+        indices[i % PREFETCH_DISTANCE] = index;
+        prefetch(&mBuckets[index]);
+    };
+    auto prefetchHead = [&](size_t i)
+    {
+        prefetch(mBuckets[indices[i % PREFETCH_DISTANCE]].head());
+    };
+
+    for(size_t i{0u}; i < n && i < PREFETCH_DISTANCE; ++i)
+        prefetchBucket(i);
+    for(size_t i{0u}; i < n && i < PREFETCH_DISTANCE / 2; ++i)
+        prefetchHead(i);
+    for(size_t i{0u}; i < n; ++i)
     {
-        Pair<K,V> pair = {key, value};
-        bucket.updateAt(it, pair);
+        if(i + PREFETCH_DISTANCE / 2 < n)
+            prefetchHead(i + PREFETCH_DISTANCE / 2);
+        auto node = findInBucket(mBuckets[indices[i % PREFETCH_DISTANCE]], keys[i]);
+        found[i] = node != nullptr;
+        if(node)
+            out[i] = node->data().value;
+        if(i + PREFETCH_DISTANCE < n)
+            prefetchBucket(i + PREFETCH_DISTANCE);
     }
 }
 
-template<class K, class V>
-void HashTable<K,V>::remove(const K &key)
+//A rehash in the middle of the batch only makes some prefetches useless
+template<class K, class V, class Hasher, class KeyEqual>
+void HashTable<K,V,Hasher,KeyEqual>::insertBatch(const K *keys, const V *values, size_t n)
 {
-    auto hash = mHashFunction(key, mBuckets.capacity());
-    LinkedList<Pair<K,V>> &bucket = mBuckets[hash];
+    for(size_t i{0u}; i < n && i < PREFETCH_DISTANCE; ++i)
+        prefetch(&mBuckets[bucketIndex(keys[i], mBuckets.size())]);
+    for(size_t i{0u}; i < n; ++i)
+    {
+        if(i + PREFETCH_DISTANCE < n)
+            prefetch(&mBuckets[bucketIndex(keys[i + PREFETCH_DISTANCE], mBuckets.size())]);
+        insert(keys[i], values[i]);
+    }
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void HashTable<K,V,Hasher,KeyEqual>::removeBatch(const K *keys, size_t n)
+{
+    for(size_t i{0u}; i < n && i < PREFETCH_DISTANCE; ++i)
+        prefetch(&mBuckets[bucketIndex(keys[i], mBuckets.size())]);
+    for(size_t i{0u}; i < n; ++i)
+    {
+        if(i + PREFETCH_DISTANCE < n)
+            prefetch(&mBuckets[bucketIndex(keys[i + PREFETCH_DISTANCE], mBuckets.size())]);
+        remove(keys[i]);
+    }
+}
+
+//Every node of the build is carved from one block, the node of an entry
+//sitting at the position of the entry in the plan, so the threads construct
+//them without touching the pool. Nodes of duplicate keys stay unconstructed
+//and go back to the pool afterwards
+template<class K, class V, class Hasher, class KeyEqual>
+template<class It>
+void HashTable<K,V,Hasher,KeyEqual>::bulkBuild(It begin, It end, size_t threadsNumber)
+{
+    static_assert(std::is_base_of<std::random_access_iterator_tag,
+                      typename std::iterator_traits<It>::iterator_category>::value,
+                  "bulkBuild needs random access iterators");
+    clear();
+    auto count = size_t(std::distance(begin, end));
+    rehash(size_t(std::ceil(count / mMaxLoadFactor)));
+    finishMigration();
+    auto bucketsNumber = mBuckets.size();
+    BulkBuildPlan plan(begin, count, bucketsNumber,
+                       sizeof(LinkedList<Pair<K,V>>) + sizeof(Node<Pair<K,V>>), threadsNumber,
+                       [this, bucketsNumber](const K &key){ return bucketIndex(key, bucketsNumber); });
+    auto nodes = mPool->allocateBlock(count);
+    std::vector<size_t> inserted(plan.partitionCount());
+    std::vector<std::vector<Node<Pair<K,V>>*>> unused(plan.partitionCount());
+
+    plan.forEachPartition([&](size_t p)
+    {
+        for(auto entry = plan.begin(p); entry != plan.end(p); ++entry)
+        {
+            const auto &[key, value] = begin[entry->index];
+            auto node = nodes + (entry - plan.begin(0));
+            LinkedList<Pair<K,V>> &bucket = mBuckets[entry->home];
+            Node<Pair<K,V>> *prev {nullptr};
+            auto it = bucket.head();
+            while(it && it->data().key < key)
+            {
+                prev = it;
+                it = it->next();
+            }
+            if(it && mKeyEqual(it->data().key, key))
+            {
+                it->data().value = value;
+                unused[p].push_back(node);
+                continue;
+            }
+            new (node) Node<Pair<K,V>>(nullptr, std::in_place, key, value);
+            if(prev)
+                bucket.insertNodeAt(prev, node);
+            else
+                bucket.pushFrontNode(node);
+            mOccupied.set(entry->home);
+            ++inserted[p];
+        }
+    });
+
+    for(size_t p{0u}; p < plan.partitionCount(); ++p)
+    {
+        mCount += inserted[p];
+        for(auto node : unused[p])
+            mPool->recycle(node);
+    }
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void HashTable<K,V,Hasher,KeyEqual>::update(const K &key, const V &value)
+{
+    if(isMigrating())
+        migrateBuckets(MIGRATION_STEP);
+    if(auto it = findNode(key))
+        it->data().value = value;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void HashTable<K,V,Hasher,KeyEqual>::update(const K &key, V &&value)
+{
+    if(isMigrating())
+        migrateBuckets(MIGRATION_STEP);
+    if(auto it = findNode(key))
+        it->data().value = std::move(value);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+bool HashTable<K,V,Hasher,KeyEqual>::removeFrom(Buckets &buckets, const K &key)
+{
+    auto hash = bucketIndex(key, buckets.capacity());
+    LinkedList<Pair<K,V>> &bucket = buckets[hash];
     auto it = bucket.head();
     while(it && key > it->data().key)
         it = it->next();
-    //auto it = findPosition(key);
-    if(it && it->data().key == key)
+    if(it && mKeyEqual(it->data().key, key))
     {
         bucket.removeAt(it);
+        if(bucket.isEmpty())
+            occupancyOf(buckets).reset(hash);
+        return true;
+    }
+    return false;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void HashTable<K,V,Hasher,KeyEqual>::remove(const K &key)
+{
+    if(isMigrating())
+        migrateBuckets(MIGRATION_STEP);
+    if(removeFrom(mBuckets, key) || (isMigrating() && removeFrom(mOldBuckets, key)))
+    {
         --mCount;
+        if(mMinLoadFactor > 0.0f && loadFactor() < mMinLoadFactor &&
+           mBuckets.size() > mMinBucketsNumber)
+            rehash(std::max(mBuckets.size() / 2, mMinBucketsNumber));
     }
 }
 
 //const K &key
-template<class K, class V>
-const V HashTable<K,V>::get(const K &key) const
+template<class K, class V, class Hasher, class KeyEqual>
+const V HashTable<K,V,Hasher,KeyEqual>::get(const K &key) const
 {
-    V val;
-    if(find(key, val))
-        val = findPosition(key)->mData.value;
+    V val {};
+    if(auto it = findNode(key))
+        val = it->data().value;
     return val;
 }
 
-template<class K, class V>
-const V HashTable<K,V>::operator[](const K &key) const
+template<class K, class V, class Hasher, class KeyEqual>
+const V HashTable<K,V,Hasher,KeyEqual>::operator[](const K &key) const
 {
     return get(key);
 }
 
-template<class K, class V>
-V& HashTable<K,V>::operator[](const K &key)
+template<class K, class V, class Hasher, class KeyEqual>
+V& HashTable<K,V,Hasher,KeyEqual>::operator[](const K &key)
 {
-    V val;
-    if(!find(key, val)) this->insert(key, val);
-    return findPosition(key)->mData.value;
+    return tryEmplaceNode(key).first->data().value;
 }
 
-template<class K, class V>
-void HashTable<K,V>::clear()
+template<class K, class V, class Hasher, class KeyEqual>
+void HashTable<K,V,Hasher,KeyEqual>::clear()
 {
-   for(size_t i{0u}; i < mBuckets.size(); ++i)
-       mBuckets[i].clear();
-   mCount = 0;
+    //Nodes of trivially destructible pairs need no per-node work, the chains
+    //are just forgotten and the pool frees whole slabs
+    auto dropNodes = [](Buckets &buckets)
+    {
+        for(size_t i{0u}; i < buckets.size(); ++i)
+        {
+            if constexpr(std::is_trivially_destructible<Pair<K,V>>::value)
+                buckets[i].detachAll();
+            else
+                buckets[i].clear();
+        }
+    };
+    dropNodes(mBuckets);
+    dropNodes(mOldBuckets);
+    if(mPool)
+        mPool->release();
+    mOccupied.reset();
+    mOldOccupied = OccupancyBitmap();
+    mOldBuckets = Buckets(0u);
+    mMigrationIndex = 0;
+    mCount = 0;
 }
 
-template<class K, class V>
-void HashTable<K,V>::print() const
+template<class K, class V, class Hasher, class KeyEqual>
+void HashTable<K,V,Hasher,KeyEqual>::print() const
 {
     for(size_t i {0u}; i < mBuckets.size(); ++i)
     {
@@ -233,85 +984,191 @@ void HashTable<K,V>::print() const
             std::cout << "---";
         std::cout << std::endl;
     }
+    if(isMigrating())
+    {
+        std::cout << "Not migrated yet:" << std::endl;
+        for(size_t i {mMigrationIndex}; i < mOldBuckets.size(); ++i)
+        {
+            for(auto it = mOldBuckets[i].head(); it != nullptr; it = it->next())
+                std::cout << " (" << it->data().key << "," << it->data().value << ") ->";
+        }
+        std::cout << std::endl;
+    }
 }
 
-template<class K, class V>
+template<class K, class V, class Hasher = DefaultHasher<K>, class KeyEqual = std::equal_to<K>>
 class HashTableIterator
 {
 public:
-    explicit HashTableIterator(HashTable<K,V> &ht);
+    explicit HashTableIterator(HashTable<K,V,Hasher,KeyEqual> &ht);
     virtual void reset();
     virtual void next();
     virtual void setValue(const V &value);
+    virtual void setValue(V &&value);
     virtual const Pair<K, V>& getData() const noexcept;
     inline bool end() const noexcept { return mIsEndOfTable; }
-    inline void setHashTable(HashTable<K,V> &ht) { mHashTable = &ht; }
+    inline void setHashTable(HashTable<K,V,Hasher,KeyEqual> &ht) { mHashTable = &ht; }
 private:
-    HashTable<K,V> *mHashTable;
+    HashTable<K,V,Hasher,KeyEqual> *mHashTable;
     size_t mCurrentBucket {0u};
     Node<Pair<K,V>> *mCurrentPosition { nullptr };
     bool mIsEndOfTable { false };
     void searchNextAvailableNode(size_t startIndex);
 };
 
-template<class K, class V>
-HashTableIterator<K,V>::HashTableIterator(HashTable<K,V> &ht):
+template<class K, class V, class Hasher, class KeyEqual>
+HashTableIterator<K,V,Hasher,KeyEqual>::HashTableIterator(HashTable<K,V,Hasher,KeyEqual> &ht):
     mHashTable(&ht)
 {
+    mHashTable->finishMigration();
     searchNextAvailableNode(0);
 }
 
-template<class K, class V>
-void HashTableIterator<K,V>::reset()
+template<class K, class V, class Hasher, class KeyEqual>
+void HashTableIterator<K,V,Hasher,KeyEqual>::reset()
 {
+    mHashTable->finishMigration();
     searchNextAvailableNode(0);
     mIsEndOfTable = false;
 }
 
-template<class K, class V>
-void HashTableIterator<K,V>::next()
+template<class K, class V, class Hasher, class KeyEqual>
+void HashTableIterator<K,V,Hasher,KeyEqual>::next()
 {
     mCurrentPosition = mCurrentPosition->next();
     if(!mCurrentPosition)
         searchNextAvailableNode(++mCurrentBucket);
 }
 
-template<class K, class V>
-void HashTableIterator<K,V>::setValue(const V &value)
+template<class K, class V, class Hasher, class KeyEqual>
+void HashTableIterator<K,V,Hasher,KeyEqual>::setValue(const V &value)
 {
-    Pair<K,V> pair = {mCurrentPosition->data().key, value};
-    mCurrentPosition->setData(pair);
+    mCurrentPosition->data().value = value;
 }
 
-template<class K, class V>
-const Pair<K, V>& HashTableIterator<K,V>::getData() const noexcept
+template<class K, class V, class Hasher, class KeyEqual>
+void HashTableIterator<K,V,Hasher,KeyEqual>::setValue(V &&value)
 {
-    return mCurrentPosition->data();
+    mCurrentPosition->data().value = std::move(value);
 }
 
-template<class K, class V>
-void HashTableIterator<K,V>::searchNextAvailableNode(size_t startIndex)
+template<class K, class V, class Hasher, class KeyEqual>
+const Pair<K, V>& HashTableIterator<K,V,Hasher,KeyEqual>::getData() const noexcept
 {
-    mIsEndOfTable = true;
-    auto hashTableSize = mHashTable->mBuckets.size();
-    if(startIndex >= hashTableSize) return;
-    for(size_t i { startIndex }; i < hashTableSize; ++i)
-    {
-        if(!mHashTable->mBuckets[i].isEmpty())
-        {
-            mCurrentBucket = i;
-            mCurrentPosition = mHashTable->mBuckets[mCurrentBucket].head();
-            mIsEndOfTable = false;
-            return;
-        }
-    }
+    return mCurrentPosition->data();
 }
 
-//Open adressing
+template<class K, class V, class Hasher, class KeyEqual>
+void HashTableIterator<K,V,Hasher,KeyEqual>::searchNextAvailableNode(size_t startIndex)
+{
+    auto i = mHashTable->mOccupied.findNext(startIndex);
+    mIsEndOfTable = i >= mHashTable->mBuckets.size();
+    if(mIsEndOfTable) return;
+    mCurrentBucket = i;
+    mCurrentPosition = mHashTable->mBuckets[mCurrentBucket].head();
+}
 
-enum class HashTableItemStatus
+template<class K, class V, class Hasher, class KeyEqual>
+template<bool IsConst>
+class HashTable<K,V,Hasher,KeyEqual>::Iterator
 {
-    EMPTY,
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Pair<K,V>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = std::conditional_t<IsConst, const Pair<K,V>*, Pair<K,V>*>;
+    using reference = std::conditional_t<IsConst, const Pair<K,V>&, Pair<K,V>&>;
+
+    Iterator() = default;
+    //A mutable iterator converts to a const one
+    template<bool OtherIsConst, class = std::enable_if_t<IsConst && !OtherIsConst>>
+    Iterator(const Iterator<OtherIsConst> &other):
+        mTable{other.mTable}, mBucket{other.mBucket}, mIsInOld{other.mIsInOld}, mNode{other.mNode}
+    {}
+    inline reference operator*() const noexcept { return mNode->data(); }
+    inline pointer operator->() const noexcept { return &mNode->data(); }
+    Iterator& operator++();
+    inline Iterator operator++(int)
+    {
+        auto copy = *this;
+        ++*this;
+        return copy;
+    }
+    friend inline bool operator==(const Iterator &lhs, const Iterator &rhs) noexcept
+    {
+        return lhs.mNode == rhs.mNode;
+    }
+    friend inline bool operator!=(const Iterator &lhs, const Iterator &rhs) noexcept
+    {
+        return lhs.mNode != rhs.mNode;
+    }
+private:
+    using Table = std::conditional_t<IsConst, const HashTable, HashTable>;
+    Table *mTable {nullptr};
+    size_t mBucket {0u};
+    bool mIsInOld {false};
+    Node<Pair<K,V>> *mNode {nullptr};       //nullptr past the end
+
+    explicit Iterator(Table *table): mTable{table} { seek(0u); }
+    void seek(size_t bucket);
+    friend class HashTable;
+    template<bool>
+    friend class Iterator;
+};
+
+//Moves to the head of the first non-empty bucket from the given one on, the
+//old buckets of a migration being searched from the migration index
+template<class K, class V, class Hasher, class KeyEqual>
+template<bool IsConst>
+void HashTable<K,V,Hasher,KeyEqual>::Iterator<IsConst>::seek(size_t bucket)
+{
+    if(!mIsInOld)
+    {
+        mBucket = mTable->mOccupied.findNext(bucket);
+        if(mBucket < mTable->mBuckets.size())
+        {
+            mNode = mTable->mBuckets[mBucket].head();
+            return;
+        }
+        if(!mTable->isMigrating())
+        {
+            mNode = nullptr;
+            return;
+        }
+        mIsInOld = true;
+        bucket = mTable->mMigrationIndex;
+    }
+    mBucket = mTable->mOldOccupied.findNext(bucket);
+    mNode = mBucket < mTable->mOldBuckets.size() ? mTable->mOldBuckets[mBucket].head() : nullptr;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<bool IsConst>
+auto HashTable<K,V,Hasher,KeyEqual>::Iterator<IsConst>::operator++() -> Iterator&
+{
+    mNode = mNode->next();
+    if(!mNode)
+        seek(mBucket + 1);
+    return *this;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+auto HashTable<K,V,Hasher,KeyEqual>::begin() -> iterator
+{
+    return iterator(this);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+auto HashTable<K,V,Hasher,KeyEqual>::begin() const -> const_iterator
+{
+    return const_iterator(this);
+}
+
+//Open adressing
+
+enum class HashTableItemStatus
+{
+    EMPTY,
     OCUPIED,
     DELETED
 };
@@ -322,91 +1179,510 @@ struct HashTableItem
     K key;
     V value;
     HashTableItemStatus status;
+    uint32_t distance;      //Distance from the home slot, kept by ROBIN_HOOD only
 };
 
 enum class CollisionResolutionMethod
 {
     LINEAR_PROBING,
     QUADRATIC_PROBING,
-    DOUBLE_HASHING
+    DOUBLE_HASHING,
+    ROBIN_HOOD              //Linear probing that keeps probe distances balanced
 };
 
-template<class K, class V>
-class OpenAddressingHashTable : public Map<K,V>
+//Probe sequences of the open addressing tables, shared so that every layout
+//walks its slots in the same order. numOfProbe counts the probes made so far
+inline size_t nextProbeIndex(CollisionResolutionMethod probingType, CapacityMode capacityMode,
+                             size_t index, size_t numOfProbe, size_t step,
+                             size_t tableSize) noexcept
+{
+    switch(probingType)
+    {
+    case CollisionResolutionMethod::QUADRATIC_PROBING:
+        //h(k,i) = (h(k) + i * (i + 1) / 2) % m, m being a power of two
+        index += numOfProbe;
+        break;
+    case CollisionResolutionMethod::DOUBLE_HASHING:
+        //h(k,i) = (h1(k) + i * h2(k)) % m
+        // h2(k) and m are relatively primes
+        index += step;
+        break;
+    case CollisionResolutionMethod::LINEAR_PROBING:
+    case CollisionResolutionMethod::ROBIN_HOOD:
+    default:
+        ++index;
+        break;
+    }
+    if(capacityMode == CapacityMode::POWER_OF_TWO)
+        return index & (tableSize - 1);
+    return index % tableSize;
+}
+
+//Extra hash of double hashing, evaluated once per operation. Power of two
+//tables take odd steps, relatively prime to their size
+template<class Hasher2, class K>
+inline size_t probeStepOf(CollisionResolutionMethod probingType, CapacityMode capacityMode,
+                          const Hasher2 &hasher, const K &key, size_t tableSize)
+{
+    if(probingType != CollisionResolutionMethod::DOUBLE_HASHING)
+        return 1u;
+    if(capacityMode == CapacityMode::POWER_OF_TWO)
+        return fullHash(hasher, key) | 1u;
+    return hasher(key, tableSize);
+}
+
+//Backward shift deletion of ROBIN_HOOD: pulls the items following the emptied
+//slot pos one slot back instead of leaving a tombstone. isDisplaced(slot) tells
+//whether the slot holds an item away from its home, moveBack(from, to) moves
+//it and shortens its distance. Returns the slot left free
+template<class IsDisplaced, class MoveBack>
+size_t shiftBackward(size_t pos, CapacityMode capacityMode, size_t tableSize,
+                     IsDisplaced isDisplaced, MoveBack moveBack)
+{
+    auto next = nextProbeIndex(CollisionResolutionMethod::ROBIN_HOOD, capacityMode, pos, 1u, 1u,
+                               tableSize);
+    while(isDisplaced(next))
+    {
+        moveBack(next, pos);
+        pos = next;
+        next = nextProbeIndex(CollisionResolutionMethod::ROBIN_HOOD, capacityMode, next, 1u, 1u,
+                              tableSize);
+    }
+    return pos;
+}
+
+template<class K, class V, class Hasher = DefaultHasher<K>, class Hasher2 = DefaultStepHasher<K>,
+         class KeyEqual = std::equal_to<K>>
+class OpenAddressingHashTable final: public Map<K,V>
 {
 public:
     explicit OpenAddressingHashTable(size_t tableSize,
-                                     std::function<size_t(const K &key, size_t maxVal)> hf,
-                                     CollisionResolutionMethod probingType,
-                                     std::function<size_t(const K &key, size_t maxVal)> hf2);
-    OpenAddressingHashTable(const OpenAddressingHashTable<K,V> &other) = default;
-    OpenAddressingHashTable(OpenAddressingHashTable<K,V> &&other) = default;
-    OpenAddressingHashTable<K,V>& operator=(const OpenAddressingHashTable<K,V> &rhs) = default;
-    OpenAddressingHashTable<K,V>& operator=(OpenAddressingHashTable<K,V> &&rhs) = default;
+                                     const Hasher &hf = Hasher(),
+                                     CollisionResolutionMethod probingType =
+                                        CollisionResolutionMethod::LINEAR_PROBING,
+                                     const Hasher2 &hf2 = Hasher2(),
+                                     const KeyEqual &keyEqual = KeyEqual());
+    explicit OpenAddressingHashTable(size_t tableSize, CollisionResolutionMethod probingType);
+    OpenAddressingHashTable(const OpenAddressingHashTable &other) = default;
+    OpenAddressingHashTable(OpenAddressingHashTable &&other) = default;
+    OpenAddressingHashTable& operator=(const OpenAddressingHashTable &rhs) = default;
+    OpenAddressingHashTable& operator=(OpenAddressingHashTable &&rhs) = default;
     //virtual ~OpenAddressingHashTable() {}
     // Map interface
     virtual void insert(const K &key, const V &value);
+    virtual void insert(K &&key, V &&value);
+    //Builds the value from args when the key is absent, otherwise leaves the
+    //table and the arguments untouched. Returns true on insertion
+    template<class... Args>
+    bool try_emplace(const K &key, Args&&... args);
+    template<class... Args>
+    bool try_emplace(K &&key, Args&&... args);
+    //Same as try_emplace
+    template<class... Args>
+    bool emplace(const K &key, Args&&... args);
+    template<class... Args>
+    bool emplace(K &&key, Args&&... args);
+    //Assigns the value of an existing key without touching the key
+    template<class M>
+    bool insert_or_assign(const K &key, M &&value);
+    template<class M>
+    bool insert_or_assign(K &&key, M &&value);
     virtual void update(const K &key, const V &value);
+    void update(const K &key, V &&value);
     virtual void remove(const K &key);
     virtual bool find(const K &key, V &value) const;
     virtual const V get(const K &key) const;
+    //Batched operations prefetch the home slots of the keys ahead of the one
+    //being resolved, so the cache misses of a batch overlap
+    void findBatch(const K *keys, size_t n, V *out, bool *found) const;
+    void insertBatch(const K *keys, const V *values, size_t n);
+    void removeBatch(const K *keys, size_t n);
+    //Replaces the content with the (key, value) pairs of the random access
+    //range [begin, end), a later duplicate key overriding an earlier one. The
+    //slots are sized once and filled by threadsNumber threads (0 means one per
+    //hardware thread), each in its own regions of mData. The few items whose
+    //probe sequence leaves their region are placed afterwards
+    template<class It>
+    void bulkBuild(It begin, It end, size_t threadsNumber = 0u);
+    template<bool IsConst>
+    class Iterator;
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+    //Forward iteration over the occupied slots. During a migration the slots
+    //of the old array not migrated yet come last. Any modification of the
+    //table invalidates the iterators. Dereferencing yields a Pair of references
+    //to the key, read-only, and to the value, so the probing fields of the
+    //slots stay out of reach
+    iterator begin();
+    inline iterator end() noexcept { return iterator(); }
+    const_iterator begin() const;
+    inline const_iterator end() const noexcept { return const_iterator(); }
+    inline const_iterator cbegin() const { return begin(); }
+    inline const_iterator cend() const noexcept { return end(); }
     virtual void print() const noexcept;
     V& operator[](const K &key);
     const V operator[](const K &key) const;
     void clear();
+    inline double maxFillFactor() const noexcept { return mMaxFillFactor; }
+    void setMaxFillFactor(double maxFillFactor);
+    inline size_t tombstoneCount() const noexcept { return mNumberOfDeleted; }
+    inline double maxTombstoneFactor() const noexcept { return mMaxTombstoneFactor; }
+    void setMaxTombstoneFactor(double maxTombstoneFactor);
+    void compact();
+    inline ResizePolicy resizePolicy() const noexcept { return mResizePolicy; }
+    inline void setResizePolicy(ResizePolicy policy) noexcept { mResizePolicy = policy; }
+    inline bool isMigrating() const noexcept { return mOldData.size() > 0; }
+    void finishMigration();
+    inline CapacityMode capacityMode() const noexcept { return mCapacityMode; }
+    //QUADRATIC_PROBING tables always stay POWER_OF_TWO, asking them for PRIME
+    //returns false and leaves the table untouched
+    bool setCapacityMode(CapacityMode mode);
+    //Probe lengths and hash skew of the slots of mData plus the resize and
+    //collision counters, see TableStats
+    TableStats stats() const;
 //private:
     Array<HashTableItem<K,V>> mData;
-    std::function<size_t(const K &key, size_t maxVal)> mHashFunction;
+    Hasher mHashFunction;
     CollisionResolutionMethod mProbingType;
-    std::function<size_t(const K &key, size_t maxVal)> mHashFunction2;
-    size_t mNumberOfOcupied;
-    inline double getFillFactor() const noexcept { return double(mNumberOfOcupied) / mData.size(); }
+    Hasher2 mHashFunction2;
+    KeyEqual mKeyEqual;
+    size_t mNumberOfDeleted {0u};
+    double mMaxFillFactor {0.7};
+    double mMaxTombstoneFactor {0.2};
+    ResizePolicy mResizePolicy {ResizePolicy::IMMEDIATE};
+    Array<HashTableItem<K,V>> mOldData {0u};
+    size_t mMigrationIndex {0u};
+    CapacityMode mCapacityMode {CapacityMode::PRIME};
+    inline double getFillFactor() const noexcept { return double(mCount) / mData.size(); }
 protected:
     using Map<K,V>::mCount;
 private:
-    void insertIntoArray(Array<HashTableItem<K,V>> &targetArray, const K &key,
-                         const V &value);
+    static constexpr size_t MIGRATION_STEP {64u};    //Old slots moved per operation
+    static constexpr size_t PREFETCH_DISTANCE {16u}; //Keys looked ahead by the batches
+    StatsCounters mCounters;
+    //Occupied slots of mData and mOldData
+    OccupancyBitmap mOccupied;
+    OccupancyBitmap mOldOccupied;
+    inline void prefetchHome(const K &key) const;
+    bool hasIn(const Array<HashTableItem<K,V>> &data, const K &key, size_t home,
+               size_t &pos) const;
+    bool hasInOld(const K &key, size_t &pos) const;
+    void migrateSlots(size_t slotsNumber);
+    void resize(size_t newSize);
+    inline size_t roundCapacity(size_t tableSize) const;
+    static inline size_t roundCapacity(size_t tableSize, CapacityMode mode);
+    static inline CapacityMode initialCapacityMode(CollisionResolutionMethod probingType) noexcept;
+    inline size_t homeIndex(const K &key, size_t tableSize) const;
+    template<class KeyArg, class... Args>
+    std::pair<size_t, bool> tryEmplaceSlot(KeyArg &&key, Args&&... args);
+    size_t placeItem(HashTableItem<K,V> &&item);
+    size_t promoteFromOld(size_t oldPos);
+    void grow();
     bool has(const K &key, size_t &pos) const;
+    bool hasFrom(const K &key, size_t home, size_t &pos) const;
+    size_t insertRobinHood(HashTableItem<K,V> &&item);
+    bool hasRobinHood(const K &key, size_t home, size_t &pos) const;
+    void removeRobinHood(size_t pos);
+    inline size_t probeStep(const K &key, size_t tableSize) const;
+    inline size_t nextProbe(size_t index, size_t numOfProbe, size_t step,
+                            size_t tableSize) const noexcept;
+    size_t probeLength(const K &key, size_t home, size_t pos) const;
+    enum class RegionPlacement { INSERTED, ASSIGNED, OVERFLOWED };
+    RegionPlacement placeInRegion(HashTableItem<K,V> &item, size_t home, size_t first,
+                                  size_t last);
+    template<class Key, class Value, class H, class H2, class E>
+    friend class MappedHashTable;
 };
 
-template<class K, class V>
-OpenAddressingHashTable<K,V>::OpenAddressingHashTable(size_t tableSize,
-                                                      std::function<size_t(const K &, size_t maxSize)> hf,
-                                                      CollisionResolutionMethod probingType,
-                                                      std::function<size_t(const K &key, size_t maxVal)> hf2):
-    Map<K,V>::Map(),mData(getPrimeNumberGreaterThan(2 * tableSize)), mHashFunction{hf},
-    mProbingType{probingType}, mHashFunction2{hf2}
-{
-    //HashTableItem<K,V> item = {K(),V(),HashTableItemStatus::EMPTY};
-    for(size_t i{0u}; i < mData.capacity(); ++i)
-        mData.add(HashTableItem<K,V>());
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::OpenAddressingHashTable(
+        size_t tableSize, const Hasher &hf, CollisionResolutionMethod probingType,
+        const Hasher2 &hf2, const KeyEqual &keyEqual):
+    Map<K,V>::Map(),
+    mData(roundCapacity(2 * tableSize, initialCapacityMode(probingType)), HashTableItem<K,V>()),
+    mHashFunction{hf}, mProbingType{probingType}, mHashFunction2{hf2}, mKeyEqual{keyEqual},
+    mCapacityMode{initialCapacityMode(probingType)}, mOccupied(mData.size())
+{}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::OpenAddressingHashTable(
+        size_t tableSize, CollisionResolutionMethod probingType):
+    OpenAddressingHashTable(tableSize, Hasher(), probingType)
+{}
 
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::insert(const K &key, const V &value)
+{
+    insert_or_assign(key, value);
 }
 
-template<class K, class V>
-void OpenAddressingHashTable<K,V>::insert(const K &key, const V &value)
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::insert(K &&key, V &&value)
+{
+    insert_or_assign(std::move(key), std::move(value));
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+template<class... Args>
+bool OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::try_emplace(const K &key,
+                                                                       Args&&... args)
+{
+    return tryEmplaceSlot(key, std::forward<Args>(args)...).second;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+template<class... Args>
+bool OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::try_emplace(K &&key, Args&&... args)
+{
+    return tryEmplaceSlot(std::move(key), std::forward<Args>(args)...).second;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+template<class... Args>
+bool OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::emplace(const K &key, Args&&... args)
+{
+    return tryEmplaceSlot(key, std::forward<Args>(args)...).second;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+template<class... Args>
+bool OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::emplace(K &&key, Args&&... args)
+{
+    return tryEmplaceSlot(std::move(key), std::forward<Args>(args)...).second;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+template<class M>
+bool OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::insert_or_assign(const K &key,
+                                                                            M &&value)
+{
+    auto [pos, isInserted] = tryEmplaceSlot(key, std::forward<M>(value));
+    if(!isInserted)
+        mData[pos].value = std::forward<M>(value);
+    return isInserted;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+template<class M>
+bool OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::insert_or_assign(K &&key, M &&value)
 {
-    insertIntoArray(mData, key, value);
-    ++mNumberOfOcupied;
-    if(getFillFactor() > 0.7f)
+    auto [pos, isInserted] = tryEmplaceSlot(std::move(key), std::forward<M>(value));
+    if(!isInserted)
+        mData[pos].value = std::forward<M>(value);
+    return isInserted;
+}
+
+//Returns the slot of the key in mData, creating it from args when the key is
+//absent. The table grows before the item is placed, so the returned slot stays
+//valid, and an item found in the old array of a migration is moved over first.
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+template<class KeyArg, class... Args>
+std::pair<size_t, bool> OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::tryEmplaceSlot(
+        KeyArg &&key, Args&&... args)
+{
+    migrateSlots(MIGRATION_STEP);
+    size_t pos{0};
+    if(has(key, pos))
+        return {pos, false};
+    if(hasInOld(key, pos))
+        return {promoteFromOld(pos), false};
+
+    if(double(mCount + 1 + mNumberOfDeleted) / mData.size() > mMaxFillFactor)
+    {
+        //Mostly tombstones: reclaiming them is enough, no need to double the memory
+        if(double(mCount + 1) / mData.size() <= mMaxFillFactor / 2)
+            compact();
+        else
+            grow();
+    }
+    pos = placeItem({std::forward<KeyArg>(key), makeInPlaceValue<V>(std::forward<Args>(args)...),
+                     HashTableItemStatus::OCUPIED, 0});
+    ++mCount;
+    return {pos, true};
+}
+
+//Moves an item of the old array into mData now, a position in the old
+//array would not last
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+size_t OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::promoteFromOld(size_t oldPos)
+{
+    auto &item = mOldData[oldPos];
+    auto pos = placeItem(std::move(item));
+    item.status = HashTableItemStatus::DELETED;
+    mOldOccupied.reset(oldPos);
+    return pos;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::grow()
+{
+    resize(roundCapacity(2 * mData.capacity()));
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::resize(size_t newSize)
+{
+    [[maybe_unused]] auto timer = mCounters.timeResize();
+    finishMigration();
+    Array<HashTableItem<K,V>> newData(newSize, HashTableItem<K,V>());
+    mOldData = std::move(mData);
+    mData = std::move(newData);
+    mOldOccupied = std::move(mOccupied);
+    mOccupied = OccupancyBitmap(newSize);
+    mNumberOfDeleted = 0;
+    mMigrationIndex = 0;
+    if(mResizePolicy == ResizePolicy::IMMEDIATE)
+        finishMigration();
+    else
+        migrateSlots(MIGRATION_STEP);
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+bool OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::setCapacityMode(CapacityMode mode)
+{
+    if(mode == mCapacityMode)
+        return true;
+    if(mProbingType == CollisionResolutionMethod::QUADRATIC_PROBING)
+        return false;
+    mCapacityMode = mode;
+    //The current slots were placed with the other reduction and cannot be
+    //searched during an incremental migration
+    auto policy = mResizePolicy;
+    mResizePolicy = ResizePolicy::IMMEDIATE;
+    resize(roundCapacity(mData.size()));
+    mResizePolicy = policy;
+    return true;
+}
+
+//Prime sizes keep every double hashing step relatively prime to the size,
+//power of two sizes get odd steps instead
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+inline size_t OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::roundCapacity(
+        size_t tableSize) const
+{
+    return roundCapacity(tableSize, mCapacityMode);
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+inline size_t OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::roundCapacity(
+        size_t tableSize, CapacityMode mode)
+{
+    if(mode == CapacityMode::POWER_OF_TWO)
+        return getPowerOfTwoNotLessThan(std::max<size_t>(tableSize, 8u));
+    return getPrimeNumberGreaterThan(tableSize);
+}
+
+//Triangular steps reach every slot only of a power of two table, on a prime
+//one they stop at half of them
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+inline CapacityMode OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::initialCapacityMode(
+        CollisionResolutionMethod probingType) noexcept
+{
+    if(probingType == CollisionResolutionMethod::QUADRATIC_PROBING)
+        return CapacityMode::POWER_OF_TWO;
+    return CapacityMode::PRIME;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+inline size_t OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::homeIndex(
+        const K &key, size_t tableSize) const
+{
+    if(mCapacityMode == CapacityMode::POWER_OF_TWO)
+        return fibonacci_hash(fullHash(mHashFunction, key), tableSize);
+    return mHashFunction(key, tableSize);
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::finishMigration()
+{
+    migrateSlots(mOldData.size());
+}
+
+//Migrated slots become tombstones, so the probe sequences of the items
+//still waiting in the old array stay intact
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::migrateSlots(size_t slotsNumber)
+{
+    if(!isMigrating()) return;
+    auto last = std::min(mMigrationIndex + slotsNumber, mOldData.size());
+    for(; mMigrationIndex < last; ++mMigrationIndex)
+    {
+        if(mOldData[mMigrationIndex].status == HashTableItemStatus::OCUPIED)
+            promoteFromOld(mMigrationIndex);
+    }
+    if(mMigrationIndex == mOldData.size())
     {
-        std::cout << "Hash table is 70% full" << std::endl;
-        Array<HashTableItem<K,V>> newData{2 * mData.capacity()};
-        for(size_t i{0u}; i < newData.capacity(); ++i)
-            newData.add(HashTableItem<K,V>());
-        for(size_t i{0u}; i < mData.size(); ++i)
+        mOldData = Array<HashTableItem<K,V>>(0u);
+        mOldOccupied = OccupancyBitmap();
+        mMigrationIndex = 0;
+    }
+}
+
+//Same-size rehash that drops every tombstone without allocating a new array.
+//Live items are first marked DELETED meaning "not placed yet", then each one
+//is moved to the first free or not yet placed slot of its probe sequence.
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::compact()
+{
+    if(mNumberOfDeleted == 0 || mProbingType == CollisionResolutionMethod::ROBIN_HOOD)
+        return;
+    [[maybe_unused]] auto timer = mCounters.timeCompaction();
+    auto tableSize = mData.size();
+    for(size_t i{0u}; i < tableSize; ++i)
+    {
+        auto &status = mData[i].status;
+        status = status == HashTableItemStatus::OCUPIED ? HashTableItemStatus::DELETED :
+                                                          HashTableItemStatus::EMPTY;
+    }
+    for(size_t i{0u}; i < tableSize; ++i)
+    {
+        while(mData[i].status == HashTableItemStatus::DELETED)
         {
-            if(mData[i].status == HashTableItemStatus::OCUPIED)
+            const K &key = mData[i].key;
+            auto targetIndex = homeIndex(key, tableSize);
+            auto step = probeStep(key, tableSize);
+            size_t numOfProbe {0u};
+            while(mData[targetIndex].status == HashTableItemStatus::OCUPIED)
+                targetIndex = nextProbe(targetIndex, ++numOfProbe, step, tableSize);
+
+            if(targetIndex == i)
+            {
+                mData[i].status = HashTableItemStatus::OCUPIED;
+            }
+            else if(mData[targetIndex].status == HashTableItemStatus::EMPTY)
+            {
+                mData[targetIndex] = std::move(mData[i]);
+                mData[targetIndex].status = HashTableItemStatus::OCUPIED;
+                mData[i].status = HashTableItemStatus::EMPTY;
+            }
+            else
             {
-                insertIntoArray(newData, mData[i].key, mData[i].value);
+                //The target holds an item that is not placed yet, take its slot
+                //and keep going with the evicted item
+                std::swap(mData[targetIndex], mData[i]);
+                mData[targetIndex].status = HashTableItemStatus::OCUPIED;
             }
         }
-        mData = newData;
     }
+    mOccupied.reset();
+    for(size_t i{0u}; i < tableSize; ++i)
+    {
+        if(mData[i].status == HashTableItemStatus::OCUPIED)
+            mOccupied.set(i);
+    }
+    mNumberOfDeleted = 0;
 }
 
-template<class K, class V>
-bool OpenAddressingHashTable<K,V>::find(const K &key, V &value) const
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::setMaxTombstoneFactor(
+        double maxTombstoneFactor)
+{
+    if(maxTombstoneFactor > 0.0 && maxTombstoneFactor < 1.0)
+        mMaxTombstoneFactor = maxTombstoneFactor;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+bool OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::find(const K &key, V &value) const
 {
     size_t pos{0};
     if(has(key, pos))
@@ -414,39 +1690,256 @@ bool OpenAddressingHashTable<K,V>::find(const K &key, V &value) const
         value = mData[pos].value;
         return true;
     }
+    if(hasInOld(key, pos))
+    {
+        value = mOldData[pos].value;
+        return true;
+    }
     return false;
 }
 
-template<class K, class V>
-void OpenAddressingHashTable<K,V>::update(const K &key, const V &value)
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+inline void OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::prefetchHome(const K &key) const
+{
+    prefetch(&mData[homeIndex(key, mData.size())]);
+}
+
+//The home slot of every key is computed once, PREFETCH_DISTANCE keys ahead,
+//and its line prefetched. The probes after it mostly share that line. During
+//a migration a key may live in either array, so the batch falls back to find()
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::findBatch(const K *keys, size_t n,
+                                                                     V *out, bool *found) const
+{
+    if(isMigrating())
+    {
+        for(size_t i{0u}; i < n; ++i)
+            found[i] = find(keys[i], out[i]);
+        return;
+    }
+    size_t homes[PREFETCH_DISTANCE];
+    auto prefetchSlot = [&](size_t i)
+    {
+        auto home = homeIndex(keys[i], mData.size());
+        homes[i % PREFETCH_DISTANCE] = home;
+        prefetch(&mData[home]);
+    };
+
+    for(size_t i{0u}; i < n && i < PREFETCH_DISTANCE; ++i)
+        prefetchSlot(i);
+    for(size_t i{0u}; i < n; ++i)
+    {
+        size_t pos{0};
+        found[i] = hasFrom(keys[i], homes[i % PREFETCH_DISTANCE], pos);
+        if(found[i])
+            out[i] = mData[pos].value;
+        if(i + PREFETCH_DISTANCE < n)
+            prefetchSlot(i + PREFETCH_DISTANCE);
+    }
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::insertBatch(const K *keys,
+                                                                       const V *values, size_t n)
+{
+    for(size_t i{0u}; i < n && i < PREFETCH_DISTANCE; ++i)
+        prefetchHome(keys[i]);
+    for(size_t i{0u}; i < n; ++i)
+    {
+        if(i + PREFETCH_DISTANCE < n)
+            prefetchHome(keys[i + PREFETCH_DISTANCE]);
+        insert(keys[i], values[i]);
+    }
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::removeBatch(const K *keys, size_t n)
+{
+    for(size_t i{0u}; i < n && i < PREFETCH_DISTANCE; ++i)
+        prefetchHome(keys[i]);
+    for(size_t i{0u}; i < n; ++i)
+    {
+        if(i + PREFETCH_DISTANCE < n)
+            prefetchHome(keys[i + PREFETCH_DISTANCE]);
+        remove(keys[i]);
+    }
+}
+
+//The overflowed items of a region are placed last, in reverse order and
+//only when their key is absent: whatever holds their key by then came later
+//in the input
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+template<class It>
+void OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::bulkBuild(It begin, It end,
+                                                                     size_t threadsNumber)
+{
+    static_assert(std::is_base_of<std::random_access_iterator_tag,
+                      typename std::iterator_traits<It>::iterator_category>::value,
+                  "bulkBuild needs random access iterators");
+    auto count = size_t(std::distance(begin, end));
+    auto tableSize = roundCapacity(size_t(std::ceil((count + 1) / mMaxFillFactor)));
+    mData = Array<HashTableItem<K,V>>(tableSize, HashTableItem<K,V>());
+    clear();
+    BulkBuildPlan plan(begin, count, tableSize, sizeof(HashTableItem<K,V>), threadsNumber,
+                       [this, tableSize](const K &key){ return homeIndex(key, tableSize); });
+    std::vector<size_t> inserted(plan.partitionCount());
+    std::vector<std::vector<HashTableItem<K,V>>> overflow(plan.partitionCount());
+
+    plan.forEachPartition([&](size_t p)
+    {
+        auto first = plan.regionBegin(p), last = plan.regionBegin(p + 1);
+        for(auto entry = plan.begin(p); entry != plan.end(p); ++entry)
+        {
+            const auto &[key, value] = begin[entry->index];
+            HashTableItem<K,V> item {key, value, HashTableItemStatus::OCUPIED, 0};
+            auto placement = placeInRegion(item, entry->home, first, last);
+            if(placement == RegionPlacement::INSERTED)
+                ++inserted[p];
+            else if(placement == RegionPlacement::OVERFLOWED)
+                overflow[p].push_back(std::move(item));
+        }
+    });
+
+    for(size_t p{0u}; p < plan.partitionCount(); ++p)
+        mCount += inserted[p];
+    for(auto &items : overflow)
+    {
+        for(auto it = items.rbegin(); it != items.rend(); ++it)
+            tryEmplaceSlot(std::move(it->key), std::move(it->value));
+    }
+}
+
+//Places an item in the slots [first, last) of a table being bulk built, which
+//hold no tombstones. When the probe sequence would leave the region the item
+//overflows, and under ROBIN_HOOD the one left in item may then be a resident
+//it displaced: the new item took that resident's slot, so the count is even
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+auto OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::placeInRegion(
+        HashTableItem<K,V> &item, size_t home, size_t first, size_t last) -> RegionPlacement
+{
+    auto tableSize = mData.size();
+    auto isInRegion = [first, last](size_t index){ return index >= first && index < last; };
+    auto targetIndex = home;
+    if(mProbingType == CollisionResolutionMethod::ROBIN_HOOD)
+    {
+        //Lookup first: a region never spills, so a key absent up to the end of
+        //the region is absent from it
+        uint32_t distance {0u};
+        while(mData[targetIndex].status == HashTableItemStatus::OCUPIED &&
+              mData[targetIndex].distance >= distance)
+        {
+            if(mKeyEqual(mData[targetIndex].key, item.key))
+            {
+                mData[targetIndex].value = std::move(item.value);
+                return RegionPlacement::ASSIGNED;
+            }
+            targetIndex = nextProbe(targetIndex, ++distance, 1, tableSize);
+            if(!isInRegion(targetIndex))
+                break;
+        }
+        targetIndex = home;
+        item.distance = 0;
+        while(mData[targetIndex].status == HashTableItemStatus::OCUPIED)
+        {
+            if(mData[targetIndex].distance < item.distance)
+                std::swap(mData[targetIndex], item);
+            targetIndex = nextProbe(targetIndex, ++item.distance, 1, tableSize);
+            if(!isInRegion(targetIndex))
+                return RegionPlacement::OVERFLOWED;
+        }
+        mData[targetIndex] = std::move(item);
+        mOccupied.set(targetIndex);
+        return RegionPlacement::INSERTED;
+    }
+
+    auto step = probeStep(item.key, tableSize);
+    size_t numOfProbe {0u};
+    while(mData[targetIndex].status == HashTableItemStatus::OCUPIED)
+    {
+        if(mKeyEqual(mData[targetIndex].key, item.key))
+        {
+            mData[targetIndex].value = std::move(item.value);
+            return RegionPlacement::ASSIGNED;
+        }
+        targetIndex = nextProbe(targetIndex, ++numOfProbe, step, tableSize);
+        if(!isInRegion(targetIndex) || numOfProbe >= tableSize)
+            return RegionPlacement::OVERFLOWED;
+    }
+    mData[targetIndex] = std::move(item);
+    mData[targetIndex].status = HashTableItemStatus::OCUPIED;
+    mOccupied.set(targetIndex);
+    return RegionPlacement::INSERTED;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::update(const K &key, const V &value)
 {
+    migrateSlots(MIGRATION_STEP);
     size_t pos{0};
     if(has(key, pos))
         mData[pos].value = value;
+    else if(hasInOld(key, pos))
+        mOldData[pos].value = value;
 }
 
-template<class K, class V>
-void OpenAddressingHashTable<K,V>::remove(const K &key)
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::update(const K &key, V &&value)
 {
+    migrateSlots(MIGRATION_STEP);
     size_t pos{0};
     if(has(key, pos))
+        mData[pos].value = std::move(value);
+    else if(hasInOld(key, pos))
+        mOldData[pos].value = std::move(value);
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::remove(const K &key)
+{
+    migrateSlots(MIGRATION_STEP);
+    size_t pos{0};
+    if(!has(key, pos))
     {
-        mData[pos].status = HashTableItemStatus::DELETED;
-        --mNumberOfOcupied;
+        if(hasInOld(key, pos))
+        {
+            mOldData[pos].status = HashTableItemStatus::DELETED;
+            mOldOccupied.reset(pos);
+            --mCount;
+        }
+        return;
+    }
+    --mCount;
+    if(mProbingType == CollisionResolutionMethod::ROBIN_HOOD)
+    {
+        removeRobinHood(pos);
+        return;
     }
+    mData[pos].status = HashTableItemStatus::DELETED;
+    mOccupied.reset(pos);
+    ++mNumberOfDeleted;
+    if(mNumberOfDeleted > mMaxTombstoneFactor * mData.size())
+        compact();
 }
 
-template<class K, class V>
-const V OpenAddressingHashTable<K, V>::get(const K &key) const
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::setMaxFillFactor(double maxFillFactor)
 {
-    V v;
+    if(maxFillFactor > 0.0 && maxFillFactor < 1.0)
+        mMaxFillFactor = maxFillFactor;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+const V OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::get(const K &key) const
+{
+    V v {};
     size_t pos{0};
-    auto isFound = has(key, pos);
-    return isFound ? mData[pos].value: v;
+    if(has(key, pos))
+        return mData[pos].value;
+    return hasInOld(key, pos) ? mOldData[pos].value : v;
 }
 
-template<class K, class V>
-void OpenAddressingHashTable<K,V>::print() const noexcept
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::print() const noexcept
 {
     for(size_t i{0u}; i < mData.capacity(); ++i)
     {
@@ -469,95 +1962,326 @@ void OpenAddressingHashTable<K,V>::print() const noexcept
     std::cout << std::endl;
 }
 
-template<class K, class V>
-void OpenAddressingHashTable<K,V>::insertIntoArray(
-        Array<HashTableItem<K,V>> &targetArray, const K &key,const V &value)
+//Items still waiting in the old array of a migration are left out
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+TableStats OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::stats() const
+{
+    TableStats stats;
+    stats.tombstones = mNumberOfDeleted;
+    auto tableSize = mData.size();
+    std::vector<uint32_t> homeCounts(tableSize);
+    size_t items {0u};
+    for(size_t i{0u}; i < tableSize; ++i)
+    {
+        if(mData[i].status != HashTableItemStatus::OCUPIED)
+            continue;
+        auto home = homeIndex(mData[i].key, tableSize);
+        ++homeCounts[home];
+        ++items;
+        stats.addProbeLength(probeLength(mData[i].key, home, i));
+    }
+    if(items)
+    {
+        double squares {0.0};
+        for(auto homeCount : homeCounts)
+            squares += double(homeCount) * homeCount;
+        stats.averageProbeLength /= items;
+        stats.skew = squares / (items + double(items) * (items - 1) / tableSize);
+    }
+    mCounters.copyTo(stats);
+    return stats;
+}
+
+//Number of slots a lookup of the key in mData visits before reaching pos
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+size_t OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::probeLength(const K &key, size_t home,
+                                                                         size_t pos) const
+{
+    if(mProbingType == CollisionResolutionMethod::ROBIN_HOOD)
+        return mData[pos].distance + 1;
+    auto tableSize = mData.size();
+    auto step = probeStep(key, tableSize);
+    size_t numOfProbe {0u};
+    for(auto targetIndex = home; targetIndex != pos && numOfProbe < tableSize;)
+        targetIndex = nextProbe(targetIndex, ++numOfProbe, step, tableSize);
+    return numOfProbe + 1;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+inline size_t OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::probeStep(
+        const K &key, size_t tableSize) const
+{
+    return probeStepOf(mProbingType, mCapacityMode, mHashFunction2, key, tableSize);
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+inline size_t OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::nextProbe(
+        size_t index, size_t numOfProbe, size_t step, size_t tableSize) const noexcept
+{
+    return nextProbeIndex(mProbingType, mCapacityMode, index, numOfProbe, step, tableSize);
+}
+
+//Moves an item whose key is absent into mData and returns its slot
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+size_t OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::placeItem(HashTableItem<K,V> &&item)
 {
-    auto targetIndex = mHashFunction(key, targetArray.size());
+    if(mProbingType == CollisionResolutionMethod::ROBIN_HOOD)
+        return insertRobinHood(std::move(item));
+    auto tableSize = mData.size();
+    auto targetIndex = homeIndex(item.key, tableSize);
+    auto step = probeStep(item.key, tableSize);
     size_t numOfProbe {0u};
-    while(targetArray[targetIndex].status == HashTableItemStatus::OCUPIED)
+    while(mData[targetIndex].status == HashTableItemStatus::OCUPIED)
+        targetIndex = nextProbe(targetIndex, ++numOfProbe, step, tableSize);
+    mCounters.addCollisions(numOfProbe > 0);
+    if(mData[targetIndex].status == HashTableItemStatus::DELETED)
+        --mNumberOfDeleted;
+    mData[targetIndex] = std::move(item);
+    mData[targetIndex].status = HashTableItemStatus::OCUPIED;
+    mOccupied.set(targetIndex);
+    return targetIndex;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+bool OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::has(const K &key, size_t &pos) const
+{
+    return hasFrom(key, homeIndex(key, mData.size()), pos);
+}
+
+//Lookup in mData for a home slot computed beforehand
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+bool OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::hasFrom(const K &key, size_t home,
+                                                                   size_t &pos) const
+{
+    if(mProbingType == CollisionResolutionMethod::ROBIN_HOOD)
+        return hasRobinHood(key, home, pos);
+    return hasIn(mData, key, home, pos);
+}
+
+//The old array of a migration holds tombstones even in ROBIN_HOOD mode,
+//so it is searched by plain probing up to the first empty slot
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+bool OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::hasInOld(const K &key, size_t &pos) const
+{
+    return isMigrating() && hasIn(mOldData, key, homeIndex(key, mOldData.size()), pos);
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+bool OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::hasIn(
+        const Array<HashTableItem<K,V>> &data, const K &key, size_t home, size_t &pos) const
+{
+    auto tableSize = data.size();
+    auto targetIndex = home;
+    auto step = probeStep(key, tableSize);
+    size_t numOfProbe {0u};
+    while(data[targetIndex].status != HashTableItemStatus::EMPTY)
     {
-        std::cout << std::endl << "Collision detected for index = " << targetIndex << std::endl;
-        size_t step{1};
-        switch(mProbingType)
+        if(data[targetIndex].status == HashTableItemStatus::OCUPIED &&
+           mKeyEqual(data[targetIndex].key, key))
         {
-        case CollisionResolutionMethod::QUADRATIC_PROBING:
-            //h(k,i) = (h(k) + c1 * i + c2 * i * i) % m;
-            step = numOfProbe * numOfProbe / 2;
-            break;
-        case CollisionResolutionMethod::DOUBLE_HASHING:
-            //h(k,i) = (h1(k) + i * h2(k)) % m
-            // h2(k) and m are relatively primes
-            step = mHashFunction2(key, targetArray.size()) * numOfProbe;
-            break;
-        case CollisionResolutionMethod::LINEAR_PROBING:
-        default:
-            break;
+            pos = targetIndex;
+            return true;
         }
-        targetIndex += step;
-        targetIndex %= targetArray.size();
-        ++numOfProbe;
+        if(++numOfProbe >= tableSize)
+            break;
+        targetIndex = nextProbe(targetIndex, numOfProbe, step, tableSize);
     }
-    targetArray[targetIndex] = {key, value, HashTableItemStatus::OCUPIED};
+    return false;
 }
 
-template<class K, class V>
-bool OpenAddressingHashTable<K, V>::has(const K &key, size_t &pos) const
+//The item that is closer to its home slot gives way, so probe distances stay short.
+//Returns the slot of the inserted item, which is where it first displaced another
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+size_t OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::insertRobinHood(
+        HashTableItem<K,V> &&newItem)
 {
-    auto targetIndex = mHashFunction(key, mData.size());
-    size_t numOfProbe {0u};
-    while(true)
+    HashTableItem<K,V> item{std::move(newItem)};
+    auto tableSize = mData.size();
+    auto targetIndex = homeIndex(item.key, tableSize);
+    auto placedIndex = tableSize;
+    item.status = HashTableItemStatus::OCUPIED;
+    item.distance = 0;
+    mCounters.addCollisions(mData[targetIndex].status == HashTableItemStatus::OCUPIED);
+    while(mData[targetIndex].status == HashTableItemStatus::OCUPIED)
     {
-        size_t step{1};
-        switch(mProbingType)
+        if(mData[targetIndex].distance < item.distance)
         {
-        case CollisionResolutionMethod::QUADRATIC_PROBING:
-            //h(k,i) = (h(k) + c1 * i + c2 * i * i) % m;
-            step = numOfProbe * numOfProbe / 2;
-            break;
-        case CollisionResolutionMethod::DOUBLE_HASHING:
-            //h(k,i) = (h1(k) + i * h2(k)) % m
-            // h2(k) and m are relatively primes
-            step = mHashFunction2(key, mData.size()) * numOfProbe;
-            break;
-        case CollisionResolutionMethod::LINEAR_PROBING:
-        default:
-            break;
+            std::swap(mData[targetIndex], item);
+            if(placedIndex == tableSize)
+                placedIndex = targetIndex;
         }
-        targetIndex += step;
-        targetIndex %= mData.size();
-        ++numOfProbe;
-        if(mData[targetIndex].status == HashTableItemStatus::EMPTY)
-            return false;
-        if(mData[targetIndex].status == HashTableItemStatus::OCUPIED &&
-           mData[targetIndex].key == key)
+        targetIndex = nextProbe(targetIndex, ++item.distance, 1, tableSize);
+    }
+    mData[targetIndex] = std::move(item);
+    mOccupied.set(targetIndex);
+    return placedIndex == tableSize ? targetIndex : placedIndex;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+bool OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::hasRobinHood(const K &key,
+                                                                        size_t home,
+                                                                        size_t &pos) const
+{
+    auto tableSize = mData.size();
+    auto targetIndex = home;
+    uint32_t distance {0u};
+    //A resident closer to home than we are means the key would have been placed before it
+    while(mData[targetIndex].status == HashTableItemStatus::OCUPIED &&
+          mData[targetIndex].distance >= distance)
+    {
+        if(mKeyEqual(mData[targetIndex].key, key))
         {
             pos = targetIndex;
             return true;
         }
+        targetIndex = nextProbe(targetIndex, ++distance, 1, tableSize);
     }
     return false;
 }
-template<class K, class V>
-V& OpenAddressingHashTable<K, V>::operator[](const K &key)
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::removeRobinHood(size_t pos)
 {
-    size_t pos{0};
-    if(!has(key, pos)) this->insert(key, V());
-    has(key, pos);
-    return mData[pos].value;
+    auto isDisplaced = [this](size_t slot)
+    {
+        return mData[slot].status == HashTableItemStatus::OCUPIED && mData[slot].distance > 0;
+    };
+    auto moveBack = [this](size_t from, size_t to)
+    {
+        mData[to] = std::move(mData[from]);
+        --mData[to].distance;
+    };
+    pos = shiftBackward(pos, mCapacityMode, mData.size(), isDisplaced, moveBack);
+    mData[pos].status = HashTableItemStatus::EMPTY;
+    mOccupied.reset(pos);
 }
 
-template<class K, class V>
-const V OpenAddressingHashTable<K, V>::operator[](const K &key) const
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+V& OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::operator[](const K &key)
+{
+    return mData[tryEmplaceSlot(key).first].value;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+const V OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::operator[](const K &key) const
 {
     return get(key);
 }
 
-template<class K, class V>
-void OpenAddressingHashTable<K, V>::clear()
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::clear()
 {
     for(size_t i{0u}; i < mData.size(); ++i)
         mData[i].status = HashTableItemStatus::EMPTY;
+    mOccupied = OccupancyBitmap(mData.size());
+    mOldData = Array<HashTableItem<K,V>>(0u);
+    mOldOccupied = OccupancyBitmap();
+    mMigrationIndex = 0;
+    mCount = 0;
+    mNumberOfDeleted = 0;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+template<bool IsConst>
+class OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::Iterator
+{
+public:
+    //reference is a proxy returned by value, hence an input iterator for
+    //the standard library even though it can go over the table again
+    using iterator_category = std::input_iterator_tag;
+    using value_type = Pair<K,V>;
+    using difference_type = std::ptrdiff_t;
+    using reference = Pair<const K&, std::conditional_t<IsConst, const V&, V&>>;
+    struct pointer
+    {
+        reference item;
+        inline const reference* operator->() const noexcept { return &item; }
+    };
+
+    Iterator() = default;
+    //A mutable iterator converts to a const one
+    template<bool OtherIsConst, class = std::enable_if_t<IsConst && !OtherIsConst>>
+    Iterator(const Iterator<OtherIsConst> &other):
+        mTable{other.mTable}, mSlot{other.mSlot}, mIsInOld{other.mIsInOld}, mItem{other.mItem}
+    {}
+    inline reference operator*() const noexcept { return {mItem->key, mItem->value}; }
+    inline pointer operator->() const noexcept { return {**this}; }
+    Iterator& operator++();
+    inline Iterator operator++(int)
+    {
+        auto copy = *this;
+        ++*this;
+        return copy;
+    }
+    friend inline bool operator==(const Iterator &lhs, const Iterator &rhs) noexcept
+    {
+        return lhs.mItem == rhs.mItem;
+    }
+    friend inline bool operator!=(const Iterator &lhs, const Iterator &rhs) noexcept
+    {
+        return lhs.mItem != rhs.mItem;
+    }
+private:
+    using Table = std::conditional_t<IsConst, const OpenAddressingHashTable,
+                                     OpenAddressingHashTable>;
+    using Item = std::conditional_t<IsConst, const HashTableItem<K,V>, HashTableItem<K,V>>;
+    Table *mTable {nullptr};
+    size_t mSlot {0u};
+    bool mIsInOld {false};
+    Item *mItem {nullptr};                  //nullptr past the end
+
+    explicit Iterator(Table *table): mTable{table} { seek(0u); }
+    void seek(size_t slot);
+    friend class OpenAddressingHashTable;
+    template<bool>
+    friend class Iterator;
+};
+
+//Moves to the first occupied slot from the given one on, the old array of a
+//migration being searched from the migration index
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+template<bool IsConst>
+void OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::Iterator<IsConst>::seek(size_t slot)
+{
+    if(!mIsInOld)
+    {
+        mSlot = mTable->mOccupied.findNext(slot);
+        if(mSlot < mTable->mData.size())
+        {
+            mItem = &mTable->mData[mSlot];
+            return;
+        }
+        if(!mTable->isMigrating())
+        {
+            mItem = nullptr;
+            return;
+        }
+        mIsInOld = true;
+        slot = mTable->mMigrationIndex;
+    }
+    mSlot = mTable->mOldOccupied.findNext(slot);
+    mItem = mSlot < mTable->mOldData.size() ? &mTable->mOldData[mSlot] : nullptr;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+template<bool IsConst>
+auto OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::Iterator<IsConst>::operator++()
+        -> Iterator&
+{
+    seek(mSlot + 1);
+    return *this;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+auto OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::begin() -> iterator
+{
+    return iterator(this);
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+auto OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::begin() const -> const_iterator
+{
+    return const_iterator(this);
 }
 
 
@@ -0,0 +1,499 @@
+#ifndef HOPSCOTCH_HASHTABLE_HPP
+#define HOPSCOTCH_HASHTABLE_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <new>
+#include <utility>
+#include <vector>
+#include "hashtable.hpp"
+
+//Hopscotch hashing: a key always lives within the NEIGHBORHOOD slots that
+//start at its home slot, and every home slot has a hop bitmap telling which
+//of them hold its keys. A lookup reads the bitmap, which shares the cache
+//line of the home slot, and compares only the slots it names, all close
+//together. An insertion takes the first free slot after the home and, while
+//that slot is out of the neighborhood, swaps it backwards with an item that
+//may move there without leaving its own neighborhood. When no item can, the
+//key goes to an overflow list of at most OVERFLOW_SIZE pairs, scanned by
+//lookups only while it is not empty, and once the list is full the table
+//grows instead, which spreads the crowded neighborhood over twice the homes.
+//Keys sharing their full hash share their home at every capacity though, so
+//when NEIGHBORHOOD of them already fill it, a further one is listed beyond
+//OVERFLOW_SIZE rather than growing the table for nothing.
+//A neighborhood of 64 slots keeps the table below its max load factor up to
+//0.9 or so, where 32 slots already give out around 0.8.
+template<class K, class V, class Hasher = DefaultHasher<K>, class KeyEqual = std::equal_to<K>>
+class HopscotchHashTable final: public Map<K,V>
+{
+public:
+    static constexpr size_t NEIGHBORHOOD {64u};
+
+    explicit HopscotchHashTable(size_t tableSize = 0u, const Hasher &hf = Hasher(),
+                                const KeyEqual &keyEqual = KeyEqual());
+    HopscotchHashTable(const HopscotchHashTable &other);
+    HopscotchHashTable(HopscotchHashTable &&other) noexcept;
+    HopscotchHashTable& operator=(const HopscotchHashTable &rhs);
+    HopscotchHashTable& operator=(HopscotchHashTable &&rhs) noexcept;
+    virtual ~HopscotchHashTable();
+    virtual void insert(const K &key, const V &value) override;
+    virtual void insert(K &&key, V &&value) override;
+    //Builds the value from args when the key is absent, otherwise leaves the
+    //table and the arguments untouched. Returns true on insertion
+    template<class... Args>
+    bool try_emplace(const K &key, Args&&... args);
+    template<class... Args>
+    bool try_emplace(K &&key, Args&&... args);
+    //Assigns the value of an existing key without touching the key
+    template<class M>
+    bool insert_or_assign(const K &key, M &&value);
+    template<class M>
+    bool insert_or_assign(K &&key, M &&value);
+    virtual void update(const K &key, const V &value) override;
+    void update(const K &key, V &&value);
+    virtual void remove(const K &key) override;
+    virtual bool find(const K &key, V &value) const override;
+    virtual const V get(const K &key) const override;
+    V& operator[](const K &key);
+    const V operator[](const K &key) const;
+    void clear();
+    virtual void print() const;
+    //Home slots, the neighborhoods of the last ones reach NEIGHBORHOOD - 1
+    //slots further
+    inline size_t capacity() const noexcept { return mCapacity; }
+    inline double loadFactor() const noexcept { return double(mCount) / mCapacity; }
+    inline double maxLoadFactor() const noexcept { return mMaxLoadFactor; }
+    void setMaxLoadFactor(double maxLoadFactor);
+    inline size_t overflowSize() const noexcept { return mOverflow.size(); }
+    void reserve(size_t count);
+protected:
+    using Map<K,V>::mCount;
+private:
+    struct Slot
+    {
+        uint64_t hop;       //Bit i: slot home + i holds a key of this home
+        uint8_t tag;        //0 when free, otherwise the high bit and 7 bits of the hash
+        alignas(Pair<K,V>) unsigned char storage[sizeof(Pair<K,V>)];
+        inline Pair<K,V>& item() noexcept { return *std::launder(reinterpret_cast<Pair<K,V>*>(storage)); }
+        inline const Pair<K,V>& item() const noexcept
+        {
+            return *std::launder(reinterpret_cast<const Pair<K,V>*>(storage));
+        }
+    };
+    static constexpr size_t IN_OVERFLOW {SIZE_MAX};
+    //Slots searched for a free one past the home before growing
+    static constexpr size_t MAX_FREE_DISTANCE {2048u};
+    //Pairs held by the overflow list before a failed placement grows the table
+    static constexpr size_t OVERFLOW_SIZE {8u};
+
+    Slot *mSlots {nullptr};
+    size_t mCapacity {0u};
+    std::vector<Pair<K,V>> mOverflow;
+    double mMaxLoadFactor {0.9};
+    Hasher mHashFunction;
+    KeyEqual mKeyEqual;
+
+    static inline uint8_t tagOf(size_t hash) noexcept { return uint8_t(0x80 | (hash & 0x7f)); }
+    inline size_t slotsNumber() const noexcept { return mCapacity + NEIGHBORHOOD - 1; }
+    inline size_t homeOf(size_t hash) const noexcept { return fibonacci_hash(hash, mCapacity); }
+    //Slot of the key or IN_OVERFLOW, overflowPos being then its index in mOverflow
+    bool has(const K &key, size_t &pos, size_t &overflowPos) const;
+    template<class KeyArg, class... Args>
+    std::pair<Pair<K,V>*, bool> tryEmplaceSlot(KeyArg &&key, Args&&... args);
+    Pair<K,V>* place(Pair<K,V> &&item, size_t hash);
+    bool isHomeSaturated(size_t home, size_t hash) const;
+    bool freeSlotNear(size_t home, size_t &pos);
+    void allocate(size_t capacity);
+    void release() noexcept;
+    void resize(size_t capacity);
+};
+
+template<class K, class V, class Hasher, class KeyEqual>
+HopscotchHashTable<K,V,Hasher,KeyEqual>::HopscotchHashTable(size_t tableSize, const Hasher &hf,
+                                                            const KeyEqual &keyEqual):
+    Map<K,V>::Map(), mHashFunction(hf), mKeyEqual(keyEqual)
+{
+    allocate(getPowerOfTwoNotLessThan(std::max<size_t>(2u, size_t(tableSize / mMaxLoadFactor) + 1)));
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+HopscotchHashTable<K,V,Hasher,KeyEqual>::HopscotchHashTable(const HopscotchHashTable &other):
+    Map<K,V>::Map(other), mMaxLoadFactor(other.mMaxLoadFactor),
+    mHashFunction(other.mHashFunction), mKeyEqual(other.mKeyEqual)
+{
+    mCount = 0;
+    allocate(other.mCapacity);
+    for(size_t i{0u}; i < other.slotsNumber(); ++i)
+    {
+        if(other.mSlots[i].tag)
+            insert(other.mSlots[i].item().key, other.mSlots[i].item().value);
+    }
+    for(const auto &item : other.mOverflow)
+        insert(item.key, item.value);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+HopscotchHashTable<K,V,Hasher,KeyEqual>::HopscotchHashTable(HopscotchHashTable &&other) noexcept:
+    Map<K,V>::Map(other), mSlots(other.mSlots), mCapacity(other.mCapacity),
+    mOverflow(std::move(other.mOverflow)), mMaxLoadFactor(other.mMaxLoadFactor),
+    mHashFunction(std::move(other.mHashFunction)), mKeyEqual(std::move(other.mKeyEqual))
+{
+    other.mSlots = nullptr;
+    other.mCapacity = 0;
+    other.mCount = 0;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+HopscotchHashTable<K,V,Hasher,KeyEqual>& HopscotchHashTable<K,V,Hasher,KeyEqual>::operator=(
+        const HopscotchHashTable &rhs)
+{
+    if(this == &rhs) return *this;
+    HopscotchHashTable copy(rhs);
+    return *this = std::move(copy);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+HopscotchHashTable<K,V,Hasher,KeyEqual>& HopscotchHashTable<K,V,Hasher,KeyEqual>::operator=(
+        HopscotchHashTable &&rhs) noexcept
+{
+    if(this == &rhs) return *this;
+    release();
+    std::swap(mSlots, rhs.mSlots);
+    std::swap(mCapacity, rhs.mCapacity);
+    std::swap(mCount, rhs.mCount);
+    mOverflow = std::move(rhs.mOverflow);
+    mMaxLoadFactor = rhs.mMaxLoadFactor;
+    mHashFunction = std::move(rhs.mHashFunction);
+    mKeyEqual = std::move(rhs.mKeyEqual);
+    return *this;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+HopscotchHashTable<K,V,Hasher,KeyEqual>::~HopscotchHashTable()
+{
+    release();
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void HopscotchHashTable<K,V,Hasher,KeyEqual>::insert(const K &key, const V &value)
+{
+    insert_or_assign(key, value);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void HopscotchHashTable<K,V,Hasher,KeyEqual>::insert(K &&key, V &&value)
+{
+    insert_or_assign(std::move(key), std::move(value));
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<class... Args>
+bool HopscotchHashTable<K,V,Hasher,KeyEqual>::try_emplace(const K &key, Args&&... args)
+{
+    return tryEmplaceSlot(key, std::forward<Args>(args)...).second;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<class... Args>
+bool HopscotchHashTable<K,V,Hasher,KeyEqual>::try_emplace(K &&key, Args&&... args)
+{
+    return tryEmplaceSlot(std::move(key), std::forward<Args>(args)...).second;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<class M>
+bool HopscotchHashTable<K,V,Hasher,KeyEqual>::insert_or_assign(const K &key, M &&value)
+{
+    auto [item, isInserted] = tryEmplaceSlot(key, std::forward<M>(value));
+    if(!isInserted)
+        item->value = std::forward<M>(value);
+    return isInserted;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<class M>
+bool HopscotchHashTable<K,V,Hasher,KeyEqual>::insert_or_assign(K &&key, M &&value)
+{
+    auto [item, isInserted] = tryEmplaceSlot(std::move(key), std::forward<M>(value));
+    if(!isInserted)
+        item->value = std::forward<M>(value);
+    return isInserted;
+}
+
+//The pair is built before a slot is searched, since making room moves
+//pairs around and may grow the table
+template<class K, class V, class Hasher, class KeyEqual>
+template<class KeyArg, class... Args>
+auto HopscotchHashTable<K,V,Hasher,KeyEqual>::tryEmplaceSlot(KeyArg &&key, Args&&... args)
+        -> std::pair<Pair<K,V>*, bool>
+{
+    size_t pos{0u}, overflowPos{0u};
+    if(has(key, pos, overflowPos))
+        return {pos == IN_OVERFLOW ? &mOverflow[overflowPos] : &mSlots[pos].item(), false};
+    if(double(mCount + 1) > mMaxLoadFactor * mCapacity)
+        resize(mCapacity * 2);
+    Pair<K,V> item{std::forward<KeyArg>(key), makeInPlaceValue<V>(std::forward<Args>(args)...)};
+    auto hash = fullHash(mHashFunction, item.key);
+    Pair<K,V> *placed {nullptr};
+    while(!(placed = place(std::move(item), hash)))
+        resize(mCapacity * 2);
+    ++mCount;
+    return {placed, true};
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void HopscotchHashTable<K,V,Hasher,KeyEqual>::update(const K &key, const V &value)
+{
+    size_t pos{0u}, overflowPos{0u};
+    if(has(key, pos, overflowPos))
+        (pos == IN_OVERFLOW ? mOverflow[overflowPos] : mSlots[pos].item()).value = value;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void HopscotchHashTable<K,V,Hasher,KeyEqual>::update(const K &key, V &&value)
+{
+    size_t pos{0u}, overflowPos{0u};
+    if(has(key, pos, overflowPos))
+        (pos == IN_OVERFLOW ? mOverflow[overflowPos] : mSlots[pos].item()).value = std::move(value);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void HopscotchHashTable<K,V,Hasher,KeyEqual>::remove(const K &key)
+{
+    size_t pos{0u}, overflowPos{0u};
+    if(!has(key, pos, overflowPos)) return;
+    --mCount;
+    if(pos == IN_OVERFLOW)
+    {
+        mOverflow.erase(mOverflow.begin() + overflowPos);
+        return;
+    }
+    auto home = homeOf(fullHash(mHashFunction, key));
+    mSlots[home].hop &= ~(uint64_t(1) << (pos - home));
+    mSlots[pos].item().~Pair<K,V>();
+    mSlots[pos].tag = 0u;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+bool HopscotchHashTable<K,V,Hasher,KeyEqual>::find(const K &key, V &value) const
+{
+    size_t pos{0u}, overflowPos{0u};
+    if(!has(key, pos, overflowPos))
+        return false;
+    value = (pos == IN_OVERFLOW ? mOverflow[overflowPos] : mSlots[pos].item()).value;
+    return true;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+const V HopscotchHashTable<K,V,Hasher,KeyEqual>::get(const K &key) const
+{
+    V value {};
+    find(key, value);
+    return value;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+V& HopscotchHashTable<K,V,Hasher,KeyEqual>::operator[](const K &key)
+{
+    return tryEmplaceSlot(key).first->value;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+const V HopscotchHashTable<K,V,Hasher,KeyEqual>::operator[](const K &key) const
+{
+    return get(key);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void HopscotchHashTable<K,V,Hasher,KeyEqual>::clear()
+{
+    for(size_t i{0u}; i < slotsNumber(); ++i)
+    {
+        if(mSlots[i].tag)
+            mSlots[i].item().~Pair<K,V>();
+        mSlots[i].tag = 0u;
+        mSlots[i].hop = 0u;
+    }
+    mOverflow.clear();
+    mCount = 0;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void HopscotchHashTable<K,V,Hasher,KeyEqual>::print() const
+{
+    for(size_t i{0u}; i < slotsNumber(); ++i)
+    {
+        std::cout << "| " << i << " | ";
+        if(mSlots[i].tag)
+            std::cout << "(" << mSlots[i].item().key << "," << mSlots[i].item().value << ")";
+        else
+            std::cout << "Empty";
+        std::cout << " | hop " << std::hex << mSlots[i].hop << std::dec << std::endl;
+    }
+    std::cout << "Overflow:";
+    for(const auto &item : mOverflow)
+        std::cout << " (" << item.key << "," << item.value << ")";
+    std::cout << std::endl;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void HopscotchHashTable<K,V,Hasher,KeyEqual>::setMaxLoadFactor(double maxLoadFactor)
+{
+    if(maxLoadFactor <= 0.0 || maxLoadFactor >= 1.0) return;
+    mMaxLoadFactor = maxLoadFactor;
+    if(loadFactor() > mMaxLoadFactor)
+        reserve(mCount);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void HopscotchHashTable<K,V,Hasher,KeyEqual>::reserve(size_t count)
+{
+    auto capacity = getPowerOfTwoNotLessThan(size_t(count / mMaxLoadFactor) + 1);
+    if(capacity > mCapacity)
+        resize(capacity);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+bool HopscotchHashTable<K,V,Hasher,KeyEqual>::has(const K &key, size_t &pos,
+                                                  size_t &overflowPos) const
+{
+    auto hash = fullHash(mHashFunction, key);
+    auto tag = tagOf(hash);
+    auto home = homeOf(hash);
+    for(auto hop = mSlots[home].hop; hop; hop &= hop - 1)
+    {
+        pos = home + __builtin_ctzll(hop);
+        if(mSlots[pos].tag == tag && mKeyEqual(mSlots[pos].item().key, key))
+            return true;
+    }
+    pos = IN_OVERFLOW;
+    for(overflowPos = 0; overflowPos < mOverflow.size(); ++overflowPos)
+    {
+        if(mKeyEqual(mOverflow[overflowPos].key, key))
+            return true;
+    }
+    return false;
+}
+
+//Places a pair whose key is absent and returns it. Returns nullptr, with
+//the pair untouched, when the table has to grow first
+template<class K, class V, class Hasher, class KeyEqual>
+Pair<K,V>* HopscotchHashTable<K,V,Hasher,KeyEqual>::place(Pair<K,V> &&item, size_t hash)
+{
+    auto home = homeOf(hash);
+    size_t pos{0u};
+    if(freeSlotNear(home, pos))
+    {
+        new (&mSlots[pos].item()) Pair<K,V>(std::move(item));
+        mSlots[pos].tag = tagOf(hash);
+        mSlots[home].hop |= uint64_t(1) << (pos - home);
+        return &mSlots[pos].item();
+    }
+    if(mOverflow.size() >= OVERFLOW_SIZE && !isHomeSaturated(home, hash))
+        return nullptr;
+    mOverflow.push_back(std::move(item));
+    return &mOverflow.back();
+}
+
+//True when every slot of the neighborhood of home holds a key of that home
+//with the given full hash, which no capacity would give a different home
+template<class K, class V, class Hasher, class KeyEqual>
+bool HopscotchHashTable<K,V,Hasher,KeyEqual>::isHomeSaturated(size_t home, size_t hash) const
+{
+    if(mSlots[home].hop != ~uint64_t(0))
+        return false;
+    for(auto pos = home; pos < home + NEIGHBORHOOD; ++pos)
+    {
+        if(fullHash(mHashFunction, mSlots[pos].item().key) != hash)
+            return false;
+    }
+    return true;
+}
+
+//Finds a free slot within the neighborhood of home: the first free slot
+//after home is moved back, each time in exchange for the farthest item that
+//can take it without leaving its own neighborhood
+template<class K, class V, class Hasher, class KeyEqual>
+bool HopscotchHashTable<K,V,Hasher,KeyEqual>::freeSlotNear(size_t home, size_t &pos)
+{
+    auto last = std::min(home + MAX_FREE_DISTANCE, slotsNumber());
+    pos = home;
+    while(pos < last && mSlots[pos].tag)
+        ++pos;
+    if(pos == last)
+        return false;
+    while(pos - home >= NEIGHBORHOOD)
+    {
+        auto moved = pos;
+        for(auto owner = pos - (NEIGHBORHOOD - 1); owner < pos && moved == pos; ++owner)
+        {
+            //Lowest set bit: the item of owner farthest from the free slot
+            auto hop = mSlots[owner].hop;
+            if(!hop) continue;
+            auto from = owner + __builtin_ctzll(hop);
+            if(from >= pos) continue;
+            new (&mSlots[pos].item()) Pair<K,V>(std::move(mSlots[from].item()));
+            mSlots[pos].tag = mSlots[from].tag;
+            mSlots[from].item().~Pair<K,V>();
+            mSlots[from].tag = 0u;
+            mSlots[owner].hop ^= (uint64_t(1) << (from - owner)) | (uint64_t(1) << (pos - owner));
+            moved = from;
+        }
+        if(moved == pos)
+            return false;
+        pos = moved;
+    }
+    return true;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void HopscotchHashTable<K,V,Hasher,KeyEqual>::allocate(size_t capacity)
+{
+    mCapacity = capacity;
+    mSlots = static_cast<Slot*>(::operator new(slotsNumber() * sizeof(Slot)));
+    for(size_t i{0u}; i < slotsNumber(); ++i)
+    {
+        mSlots[i].hop = 0u;
+        mSlots[i].tag = 0u;
+    }
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void HopscotchHashTable<K,V,Hasher,KeyEqual>::release() noexcept
+{
+    if(!mSlots) return;
+    clear();
+    ::operator delete(mSlots);
+    mSlots = nullptr;
+    mCapacity = 0;
+}
+
+//Reinserting into the new slots can hit a neighborhood no hop frees while
+//the overflow list is full. The table then doubles again, taking along the
+//pairs placed so far, before the remaining ones are placed
+template<class K, class V, class Hasher, class KeyEqual>
+void HopscotchHashTable<K,V,Hasher,KeyEqual>::resize(size_t capacity)
+{
+    auto oldSlots = mSlots;
+    auto oldSlotsNumber = slotsNumber();
+    auto oldOverflow = std::move(mOverflow);
+    mOverflow.clear();
+    allocate(capacity);
+    auto move = [this](Pair<K,V> &item)
+    {
+        auto hash = fullHash(mHashFunction, item.key);
+        while(!place(std::move(item), hash))
+            resize(mCapacity * 2);
+    };
+    for(size_t i{0u}; i < oldSlotsNumber; ++i)
+    {
+        if(!oldSlots[i].tag) continue;
+        move(oldSlots[i].item());
+        oldSlots[i].item().~Pair<K,V>();
+    }
+    for(auto &item : oldOverflow)
+        move(item);
+    ::operator delete(oldSlots);
+}
+
+#endif // HOPSCOTCH_HASHTABLE_HPP
@@ -1,14 +1,18 @@
 #include "hashtable.hpp"
+#include "swiss_hashtable.hpp"
+#include "concurrent_hashtable.hpp"
 #include "hash_utils.hpp"
 #include "point.hpp"
 #include <iostream>
 #include <ctime>
 #include <string>
+#include <thread>
+#include <vector>
 
 int main()
 {
     std::cout << "*********Hash table**********" << std::endl;
-    HashTable<int, std::string> hash_table(11, [](const int &key, size_t max){
+    HashTable<int, std::string, FunctionHasher<int>> hash_table(11, [](const int &key, size_t max){
         return key % max;
     });
     hash_table.insert(179, "Mashkov");
@@ -62,7 +66,7 @@ int main()
 
 
     std::cout << "******* Hash table iterator ********" << std::endl;
-    HashTableIterator<int, std::string> cursor(hash_table);
+    HashTableIterator<int, std::string, FunctionHasher<int>> cursor(hash_table);
     cursor.reset();
 
     for(;!cursor.end();cursor.next())
@@ -73,7 +77,8 @@ int main()
     }
 
     std::cout << "Open adressing hash-table" << std::endl;
-    OpenAddressingHashTable<std::string, double> oaht(10, &hash_string2,
+    OpenAddressingHashTable<std::string, double, FunctionHasher<std::string>,
+                            FunctionHasher<std::string>> oaht(10, &hash_string2,
                                                       CollisionResolutionMethod::QUADRATIC_PROBING,
                                                       &hash_sedgwick);
     oaht.print();
@@ -102,6 +107,9 @@ int main()
     std::cout << "*****" << std::endl;
     oaht.print();
     std::cout << "Fill factor = " << oaht.getFillFactor() << std::endl;
+    auto stats = oaht.stats();
+    std::cout << "Collisions = " << stats.collisions << ", resizes = " << stats.resizes
+              << ", average probe length = " << stats.averageProbeLength << std::endl;
 
     double weight = 0;
     if(oaht.find("Valuev", weight))
@@ -114,5 +122,66 @@ int main()
     std::cout << "Tyson weight is " << oaht["Tyson"] << std::endl;
     oaht.print();
 
+    std::cout << "Swiss hash-table" << std::endl;
+    SwissHashTable<std::string, double> swiss(10);
+    swiss.insert("Valuev", 144);
+    swiss.insert("Lewis", 116);
+    swiss.insert("Tyson", 109);
+    swiss.remove("Lewis");
+    swiss["Tyson"] = 110;
+    if(swiss.find("Valuev", weight))
+        std::cout << "Valuev's weight is " << weight << " kg." << std::endl;
+    std::cout << "Tyson weight is " << swiss["Tyson"] << std::endl;
+    std::cout << "Size of swiss hash table = " << swiss.count() << std::endl;
+
+    std::cout << "Concurrent hash-table" << std::endl;
+    ConcurrentHashTable<int, int> hits(11);
+    std::vector<std::thread> workers;
+    for(int t = 0; t < 4; ++t)
+    {
+        workers.emplace_back([&hits]{
+            for(int i = 0; i < 1000; ++i)
+                hits.merge(i % 10, 1, [](const int &stored, const int &value){ return stored + value; });
+        });
+    }
+    for(auto &worker : workers)
+        worker.join();
+    std::cout << "Hits of 7 = " << hits.get(7) << std::endl;
+
+    //Writers on few stripes grow a small table while readers look their keys
+    //up, so lookups keep racing with resizes and retry in lockBucket
+    ConcurrentHashTable<int, int> shared(3, 4);
+    const int threadsNumber = 4, keysPerThread = 20000;
+    std::vector<std::thread> writers, readers;
+    for(int t = 0; t < threadsNumber; ++t)
+    {
+        writers.emplace_back([&shared, t]{
+            for(int i = t * keysPerThread; i < (t + 1) * keysPerThread; ++i)
+                shared.insert(i, 2 * i);
+        });
+        readers.emplace_back([&shared, t]{
+            for(int i = t * keysPerThread; i < (t + 1) * keysPerThread; ++i)
+                shared.contains(i);
+        });
+    }
+    for(auto &writer : writers)
+        writer.join();
+    for(auto &reader : readers)
+        reader.join();
+    auto isConsistent = shared.count() == size_t(threadsNumber * keysPerThread);
+    for(int i = 0; isConsistent && i < threadsNumber * keysPerThread; ++i)
+    {
+        int value = 0;
+        isConsistent = shared.find(i, value) && value == 2 * i;
+    }
+    std::cout << "Concurrent inserts " << (isConsistent ? "consistent" : "LOST")
+              << ", buckets = " << shared.bucketCount() << std::endl;
+    auto bucketsNumber = shared.bucketCount();
+    shared.setMaxLoadFactor(shared.maxLoadFactor());
+    shared.rehash(bucketsNumber);
+    std::cout << "Rehash to the current size "
+              << (shared.bucketCount() == bucketsNumber ? "kept" : "changed")
+              << " the bucket count" << std::endl;
+
     return 0;
 }
@@ -0,0 +1,368 @@
+#ifndef OA_SNAPSHOT_HPP
+#define OA_SNAPSHOT_HPP
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "hashtable.hpp"
+
+//On-disk image of an OpenAddressingHashTable:
+//  [SnapshotHeader, padded to SNAPSHOT_HEADER_SIZE][slots][key blob]
+//The slots are the table's slot array as it is in memory, so the table can be
+//mapped and probed in place. String keys are stored as (offset, length) into
+//the blob that follows the slots. Values (and non-string keys) must be
+//trivially copyable. The file is written in the byte order of the machine.
+
+constexpr char SNAPSHOT_MAGIC[8] {'T', 'E', 'H', 'T', 'S', 'N', 'A', 'P'};
+constexpr uint32_t SNAPSHOT_VERSION {1u};
+constexpr uint32_t SNAPSHOT_BYTE_ORDER {0x01020304u};
+constexpr size_t SNAPSHOT_HEADER_SIZE {128u};
+constexpr size_t SNAPSHOT_CHUNK_SIZE {1u << 20};    //Bytes per checksum step
+
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t probingType;
+    uint32_t capacityMode;
+    uint32_t keySize;           //0 for string keys
+    uint32_t valueSize;
+    uint64_t slotSize;
+    uint64_t slotCount;
+    uint64_t itemCount;
+    uint64_t blobSize;
+    uint64_t hasherCheck;       //Hash of a default key, catches a different hasher
+    uint64_t checksum;          //Of everything after the header
+};
+
+static_assert(sizeof(SnapshotHeader) <= SNAPSHOT_HEADER_SIZE, "Snapshot header too large");
+
+template<class V>
+struct SnapshotStringItem
+{
+    uint64_t offset;            //Of the key in the blob
+    uint64_t length;
+    V value;
+    HashTableItemStatus status;
+    uint32_t distance;
+};
+
+template<class K, class V>
+using SnapshotSlot = std::conditional_t<std::is_same<K, std::string>::value,
+                                        SnapshotStringItem<V>, HashTableItem<K,V>>;
+
+//Checksum of the payload, one hash_string64 per chunk chained through mix64
+inline uint64_t snapshotChecksum(uint64_t checksum, const char *chunk, size_t length,
+                                 size_t chunkIndex) noexcept
+{
+    return mix64(checksum ^ hash_string64(chunk, length, chunkIndex));
+}
+
+//Writes the payload in chunks and checksums it on the way
+class SnapshotWriter
+{
+public:
+    explicit SnapshotWriter(std::ofstream &file): mFile(file) { mBuffer.reserve(SNAPSHOT_CHUNK_SIZE); }
+    void write(const void *data, size_t length)
+    {
+        auto bytes = static_cast<const char*>(data);
+        while(length)
+        {
+            auto part = std::min(length, SNAPSHOT_CHUNK_SIZE - mBuffer.size());
+            mBuffer.insert(mBuffer.end(), bytes, bytes + part);
+            bytes += part;
+            length -= part;
+            if(mBuffer.size() == SNAPSHOT_CHUNK_SIZE)
+                flush();
+        }
+    }
+    uint64_t finish()
+    {
+        if(!mBuffer.empty())
+            flush();
+        return mChecksum;
+    }
+private:
+    std::ofstream &mFile;
+    std::vector<char> mBuffer;
+    uint64_t mChecksum {0u};
+    size_t mChunks {0u};
+    void flush()
+    {
+        mChecksum = snapshotChecksum(mChecksum, mBuffer.data(), mBuffer.size(), mChunks++);
+        mFile.write(mBuffer.data(), mBuffer.size());
+        mBuffer.clear();
+    }
+};
+
+//Saves the table to path, through a temporary file renamed at the end so a
+//crash never leaves a torn snapshot behind. A running migration is finished
+//first. Returns false on I/O failure
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+bool saveSnapshot(OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual> &table,
+                  const std::string &path)
+{
+    constexpr bool isStringKey {std::is_same<K, std::string>::value};
+    static_assert(isStringKey || std::is_trivially_copyable<K>::value,
+                  "Snapshot keys must be strings or trivially copyable");
+    static_assert(std::is_trivially_copyable<V>::value, "Snapshot values must be trivially copyable");
+    using Slot = SnapshotSlot<K,V>;
+
+    table.finishMigration();
+    const auto &data = table.mData;
+    auto tmpPath = path + ".tmp";
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    if(!file)
+        return false;
+
+    SnapshotHeader header {};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.probingType = uint32_t(table.mProbingType);
+    header.capacityMode = uint32_t(table.mCapacityMode);
+    header.keySize = isStringKey ? 0u : sizeof(K);
+    header.valueSize = sizeof(V);
+    header.slotSize = sizeof(Slot);
+    header.slotCount = data.size();
+    header.itemCount = table.count();
+    header.hasherCheck = fullHash(table.mHashFunction, K());
+    char headerBytes[SNAPSHOT_HEADER_SIZE] {};
+    file.write(headerBytes, sizeof(headerBytes));
+
+    SnapshotWriter writer(file);
+    if constexpr(isStringKey)
+    {
+        //Pass over the slots with running blob offsets, then over the keys
+        for(size_t i{0u}; i < data.size(); ++i)
+        {
+            const auto &item = data[i];
+            Slot slot {};
+            slot.status = item.status;
+            if(item.status == HashTableItemStatus::OCUPIED)
+            {
+                slot.offset = header.blobSize;
+                slot.length = item.key.size();
+                slot.value = item.value;
+                slot.distance = item.distance;
+                header.blobSize += item.key.size();
+            }
+            writer.write(&slot, sizeof(slot));
+        }
+        for(size_t i{0u}; i < data.size(); ++i)
+        {
+            if(data[i].status == HashTableItemStatus::OCUPIED)
+                writer.write(data[i].key.data(), data[i].key.size());
+        }
+    }
+    else
+    {
+        if(data.size())
+            writer.write(&data[0], data.size() * sizeof(Slot));
+    }
+    header.checksum = writer.finish();
+
+    std::memcpy(headerBytes, &header, sizeof(header));
+    file.seekp(0);
+    file.write(headerBytes, sizeof(headerBytes));
+    file.close();
+    if(!file || std::rename(tmpPath.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+//Read-only table served straight from a memory-mapped snapshot: open() checks
+//the header and maps the file, no slot is read or copied until a lookup
+//touches its page. The hashers must be the ones the table was saved with.
+//String keys are compared bytewise, KeyEqual applies to other keys.
+template<class K, class V, class Hasher = DefaultHasher<K>, class Hasher2 = DefaultStepHasher<K>,
+         class KeyEqual = std::equal_to<K>>
+class MappedHashTable
+{
+public:
+    explicit MappedHashTable(const Hasher &hf = Hasher(), const Hasher2 &hf2 = Hasher2(),
+                             const KeyEqual &keyEqual = KeyEqual());
+    MappedHashTable(const MappedHashTable &other) = delete;
+    MappedHashTable& operator=(const MappedHashTable &rhs) = delete;
+    ~MappedHashTable();
+    //Returns false when the file is missing, truncated or of another format,
+    //version, key/value layout or hasher
+    bool open(const std::string &path);
+    void close() noexcept;
+    //Checksums the whole payload, which reads every page of the file
+    bool verify() const;
+    inline bool isOpen() const noexcept { return mMapping != nullptr; }
+    inline size_t count() const noexcept { return mHeader.itemCount; }
+    bool find(const K &key, V &value) const;
+    //Points into the mapping, nullptr when the key is absent
+    const V* lookup(const K &key) const;
+private:
+    using Slot = SnapshotSlot<K,V>;
+    static constexpr bool IS_STRING_KEY {std::is_same<K, std::string>::value};
+
+    //Empty table whose hashers and probing rules are used on the mapped slots
+    OpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual> mProbing;
+    void *mMapping {nullptr};
+    size_t mMappingSize {0u};
+    SnapshotHeader mHeader {};
+    const Slot *mSlots {nullptr};
+    const char *mBlob {nullptr};
+    inline bool isKeyOf(const Slot &slot, const K &key) const;
+};
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+MappedHashTable<K,V,Hasher,Hasher2,KeyEqual>::MappedHashTable(const Hasher &hf, const Hasher2 &hf2,
+                                                              const KeyEqual &keyEqual):
+    mProbing(0u, hf, CollisionResolutionMethod::LINEAR_PROBING, hf2, keyEqual)
+{
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+MappedHashTable<K,V,Hasher,Hasher2,KeyEqual>::~MappedHashTable()
+{
+    close();
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+bool MappedHashTable<K,V,Hasher,Hasher2,KeyEqual>::open(const std::string &path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+    struct stat fileStat;
+    if(fstat(fd, &fileStat) != 0 || size_t(fileStat.st_size) < SNAPSHOT_HEADER_SIZE)
+    {
+        ::close(fd);
+        return false;
+    }
+    mMappingSize = fileStat.st_size;
+    mMapping = mmap(nullptr, mMappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(mMapping == MAP_FAILED)
+    {
+        mMapping = nullptr;
+        return false;
+    }
+
+    std::memcpy(&mHeader, mMapping, sizeof(mHeader));
+    auto payloadSize = mMappingSize - SNAPSHOT_HEADER_SIZE;
+    auto isValid = std::memcmp(mHeader.magic, SNAPSHOT_MAGIC, sizeof(mHeader.magic)) == 0 &&
+                   mHeader.version == SNAPSHOT_VERSION &&
+                   mHeader.byteOrder == SNAPSHOT_BYTE_ORDER &&
+                   mHeader.probingType <= uint32_t(CollisionResolutionMethod::ROBIN_HOOD) &&
+                   mHeader.capacityMode <= uint32_t(CapacityMode::POWER_OF_TWO) &&
+                   mHeader.keySize == (IS_STRING_KEY ? 0u : sizeof(K)) &&
+                   mHeader.valueSize == sizeof(V) && mHeader.slotSize == sizeof(Slot) &&
+                   mHeader.slotCount > 0 && mHeader.slotCount <= payloadSize / sizeof(Slot) &&
+                   mHeader.blobSize == payloadSize - mHeader.slotCount * sizeof(Slot) &&
+                   mHeader.hasherCheck == fullHash(mProbing.mHashFunction, K());
+    if(!isValid)
+    {
+        close();
+        return false;
+    }
+    mProbing.mProbingType = CollisionResolutionMethod(mHeader.probingType);
+    mProbing.mCapacityMode = CapacityMode(mHeader.capacityMode);
+    auto bytes = static_cast<const char*>(mMapping) + SNAPSHOT_HEADER_SIZE;
+    mSlots = reinterpret_cast<const Slot*>(bytes);
+    mBlob = bytes + mHeader.slotCount * sizeof(Slot);
+    //Lookups jump around, read-ahead would only load pages nobody asked for
+    madvise(mMapping, mMappingSize, MADV_RANDOM);
+    return true;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void MappedHashTable<K,V,Hasher,Hasher2,KeyEqual>::close() noexcept
+{
+    if(mMapping)
+        munmap(mMapping, mMappingSize);
+    mMapping = nullptr;
+    mMappingSize = 0;
+    mHeader = SnapshotHeader{};
+    mSlots = nullptr;
+    mBlob = nullptr;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+bool MappedHashTable<K,V,Hasher,Hasher2,KeyEqual>::verify() const
+{
+    if(!isOpen()) return false;
+    auto bytes = static_cast<const char*>(mMapping) + SNAPSHOT_HEADER_SIZE;
+    auto payloadSize = mMappingSize - SNAPSHOT_HEADER_SIZE;
+    uint64_t checksum {0u};
+    for(size_t offset{0u}, chunk{0u}; offset < payloadSize; offset += SNAPSHOT_CHUNK_SIZE, ++chunk)
+    {
+        auto length = std::min(SNAPSHOT_CHUNK_SIZE, payloadSize - offset);
+        checksum = snapshotChecksum(checksum, bytes + offset, length, chunk);
+    }
+    return checksum == mHeader.checksum;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+bool MappedHashTable<K,V,Hasher,Hasher2,KeyEqual>::find(const K &key, V &value) const
+{
+    if(auto found = lookup(key))
+    {
+        value = *found;
+        return true;
+    }
+    return false;
+}
+
+//Same probe sequences as OpenAddressingHashTable::hasIn and hasRobinHood
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+const V* MappedHashTable<K,V,Hasher,Hasher2,KeyEqual>::lookup(const K &key) const
+{
+    if(!isOpen()) return nullptr;
+    auto tableSize = mHeader.slotCount;
+    auto targetIndex = mProbing.homeIndex(key, tableSize);
+    if(mProbing.mProbingType == CollisionResolutionMethod::ROBIN_HOOD)
+    {
+        uint32_t distance {0u};
+        while(mSlots[targetIndex].status == HashTableItemStatus::OCUPIED &&
+              mSlots[targetIndex].distance >= distance)
+        {
+            if(isKeyOf(mSlots[targetIndex], key))
+                return &mSlots[targetIndex].value;
+            targetIndex = mProbing.nextProbe(targetIndex, ++distance, 1, tableSize);
+        }
+        return nullptr;
+    }
+    auto step = mProbing.probeStep(key, tableSize);
+    size_t numOfProbe {0u};
+    while(mSlots[targetIndex].status != HashTableItemStatus::EMPTY)
+    {
+        if(mSlots[targetIndex].status == HashTableItemStatus::OCUPIED &&
+           isKeyOf(mSlots[targetIndex], key))
+            return &mSlots[targetIndex].value;
+        if(++numOfProbe >= tableSize)
+            break;
+        targetIndex = mProbing.nextProbe(targetIndex, numOfProbe, step, tableSize);
+    }
+    return nullptr;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+inline bool MappedHashTable<K,V,Hasher,Hasher2,KeyEqual>::isKeyOf(const Slot &slot,
+                                                                  const K &key) const
+{
+    if constexpr(IS_STRING_KEY)
+        return slot.length == key.size() && slot.offset <= mHeader.blobSize - slot.length &&
+               std::memcmp(mBlob + slot.offset, key.data(), key.size()) == 0;
+    else
+        return mProbing.mKeyEqual(slot.key, key);
+}
+
+#endif // OA_SNAPSHOT_HPP
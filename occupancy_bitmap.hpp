@@ -0,0 +1,53 @@
+#ifndef OCCUPANCY_BITMAP_HPP
+#define OCCUPANCY_BITMAP_HPP
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+//One bit per bucket (slot) of a table, set while it holds an item. Iteration
+//jumps from one set bit to the next a word at a time, so the empty stretches
+//of a sparse table cost one load per 64 buckets instead of one per bucket.
+class OccupancyBitmap
+{
+public:
+    static constexpr size_t WORD_BITS {64u};
+
+    explicit OccupancyBitmap(size_t size = 0u):
+        mSize{size}, mWords((size + WORD_BITS - 1) / WORD_BITS, 0u)
+    {}
+    inline size_t size() const noexcept { return mSize; }
+    inline bool test(size_t pos) const noexcept
+    {
+        return mWords[pos / WORD_BITS] >> (pos % WORD_BITS) & 1u;
+    }
+    inline void set(size_t pos) noexcept { mWords[pos / WORD_BITS] |= uint64_t(1) << (pos % WORD_BITS); }
+    inline void reset(size_t pos) noexcept { mWords[pos / WORD_BITS] &= ~(uint64_t(1) << (pos % WORD_BITS)); }
+    inline void reset() noexcept
+    {
+        for(auto &word : mWords)
+            word = 0u;
+    }
+    //First set bit at or after pos, size() when there is none
+    inline size_t findNext(size_t pos) const noexcept;
+private:
+    size_t mSize;
+    std::vector<uint64_t> mWords;
+};
+
+inline size_t OccupancyBitmap::findNext(size_t pos) const noexcept
+{
+    if(pos >= mSize) return mSize;
+    auto index = pos / WORD_BITS;
+    //Bits below pos are masked off the first word
+    auto word = mWords[index] & (~uint64_t(0) << (pos % WORD_BITS));
+    while(!word)
+    {
+        if(++index == mWords.size())
+            return mSize;
+        word = mWords[index];
+    }
+    return index * WORD_BITS + __builtin_ctzll(word);
+}
+
+#endif // OCCUPANCY_BITMAP_HPP
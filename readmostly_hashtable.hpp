@@ -0,0 +1,445 @@
+#ifndef READMOSTLY_HASHTABLE_HPP
+#define READMOSTLY_HASHTABLE_HPP
+
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include "hashtable.hpp"
+
+//Open addressing table for data that is loaded once and then read by many
+//threads. Slots hold atomic pointers to immutable entries, so find() and get()
+//take no lock: they probe with plain loads and copy the value out of the
+//entry they land on. Writers are serialized by a mutex and never modify a
+//published entry, an update publishes a new one. Replaced entries and the
+//slot arrays dropped by a resize are retired and freed once no reader can
+//still see them (see ReadEpochs).
+template<class K, class V, class Hasher = DefaultHasher<K>, class KeyEqual = std::equal_to<K>>
+class ReadMostlyHashTable final: public Map<K,V>
+{
+public:
+    explicit ReadMostlyHashTable(size_t tableSize, const Hasher &hf = Hasher(),
+                                 const KeyEqual &keyEqual = KeyEqual());
+    //Loads every item of an OpenAddressingHashTable
+    template<class H, class H2, class E>
+    explicit ReadMostlyHashTable(const OpenAddressingHashTable<K,V,H,H2,E> &source,
+                                 const Hasher &hf = Hasher(),
+                                 const KeyEqual &keyEqual = KeyEqual());
+    ReadMostlyHashTable(const ReadMostlyHashTable &other) = delete;
+    ReadMostlyHashTable& operator=(const ReadMostlyHashTable &rhs) = delete;
+    //No reader may be running
+    virtual ~ReadMostlyHashTable();
+    virtual size_t count() const noexcept override { return mSize.load(std::memory_order_relaxed); }
+    virtual void insert(const K &key, const V &value) override;
+    virtual void insert(K &&key, V &&value) override;
+    virtual void update(const K &key, const V &value) override;
+    virtual void remove(const K &key) override;
+    virtual bool find(const K &key, V &value) const override;
+    virtual const V get(const K &key) const override;
+    bool contains(const K &key) const;
+    void clear();
+    void reserve(size_t count);
+    inline size_t capacity() const noexcept { return mTable.load(std::memory_order_relaxed)->capacity; }
+    inline double maxFillFactor() const noexcept { return mMaxFillFactor; }
+    void setMaxFillFactor(double maxFillFactor);
+private:
+    struct Entry
+    {
+        K key;
+        V value;
+        size_t hash;
+    };
+
+    struct Table
+    {
+        explicit Table(size_t tableCapacity);
+        size_t capacity;        //Always a power of two
+        std::unique_ptr<std::atomic<Entry*>[]> slots;
+    };
+
+    //Epoch based reclamation in the style of sleepable RCU. A reader adds
+    //itself to the counter of the current epoch parity in its slot, a writer
+    //that wants to free retired memory flips the parity and waits for the
+    //counters of the old one to drain, twice, so that a reader which read the
+    //parity just before a flip is covered too. Threads are spread over the
+    //slots, each on its own cache line, so readers do not share a counter.
+    class ReadEpochs
+    {
+    public:
+        void enter(size_t &parity) noexcept;
+        void leave(size_t parity) noexcept;
+        void synchronize() noexcept;
+    private:
+        static constexpr size_t SLOTS_NUMBER {64u};
+        struct alignas(64) Slot
+        {
+            std::atomic<size_t> readers[2] {};
+        };
+        std::atomic<size_t> mEpoch {0u};
+        Slot mSlots[SLOTS_NUMBER];
+        static size_t slotIndex() noexcept;
+    };
+
+    class ReadGuard
+    {
+    public:
+        explicit ReadGuard(ReadEpochs &epochs) noexcept: mEpochs(epochs) { mEpochs.enter(mParity); }
+        ~ReadGuard() { mEpochs.leave(mParity); }
+    private:
+        ReadEpochs &mEpochs;
+        size_t mParity {0u};
+    };
+
+    static constexpr size_t RECLAIM_THRESHOLD {64u};  //Retired entries freed in one go
+    static inline Entry* tombstone() noexcept { return reinterpret_cast<Entry*>(uintptr_t(1)); }
+
+    std::atomic<Table*> mTable;
+    Hasher mHashFunction;
+    KeyEqual mKeyEqual;
+    double mMaxFillFactor {0.7};
+    std::atomic<size_t> mSize {0u};
+    mutable ReadEpochs mEpochs;
+    //Writer side, guarded by mWriteMutex
+    std::mutex mWriteMutex;
+    size_t mNumberOfDeleted {0u};
+    Array<Entry*> mRetiredEntries {0u};
+    Array<Table*> mRetiredTables {0u};
+
+    const Entry* findEntry(const Table *table, const K &key, size_t hash) const;
+    size_t findSlot(const Table *table, const K &key, size_t hash, bool &isFound) const;
+    void publish(Entry *entry);
+    void rebuild(size_t newCapacity);
+    size_t capacityFor(size_t count) const;
+    void retire(Entry *entry);
+    void reclaim();
+};
+
+template<class K, class V, class Hasher, class KeyEqual>
+ReadMostlyHashTable<K,V,Hasher,KeyEqual>::Table::Table(size_t tableCapacity):
+    capacity{tableCapacity}, slots{new std::atomic<Entry*>[tableCapacity]}
+{
+    for(size_t i{0u}; i < capacity; ++i)
+        slots[i].store(nullptr, std::memory_order_relaxed);
+}
+
+//The fence pairs with the one of synchronize(): either the writer sees this
+//reader in the counter, or this reader sees every store the writer made
+//before retiring memory
+template<class K, class V, class Hasher, class KeyEqual>
+void ReadMostlyHashTable<K,V,Hasher,KeyEqual>::ReadEpochs::enter(size_t &parity) noexcept
+{
+    parity = mEpoch.load(std::memory_order_relaxed) & 1u;
+    mSlots[slotIndex()].readers[parity].fetch_add(1u, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void ReadMostlyHashTable<K,V,Hasher,KeyEqual>::ReadEpochs::leave(size_t parity) noexcept
+{
+    mSlots[slotIndex()].readers[parity].fetch_sub(1u, std::memory_order_release);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void ReadMostlyHashTable<K,V,Hasher,KeyEqual>::ReadEpochs::synchronize() noexcept
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for(int flip{0}; flip < 2; ++flip)
+    {
+        auto parity = mEpoch.fetch_add(1u, std::memory_order_seq_cst) & 1u;
+        for(size_t i{0u}; i < SLOTS_NUMBER; ++i)
+        {
+            while(mSlots[i].readers[parity].load(std::memory_order_acquire) != 0)
+                std::this_thread::yield();
+        }
+    }
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+size_t ReadMostlyHashTable<K,V,Hasher,KeyEqual>::ReadEpochs::slotIndex() noexcept
+{
+    static std::atomic<size_t> nextIndex {0u};
+    thread_local size_t index = nextIndex.fetch_add(1u, std::memory_order_relaxed) % SLOTS_NUMBER;
+    return index;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+ReadMostlyHashTable<K,V,Hasher,KeyEqual>::ReadMostlyHashTable(size_t tableSize, const Hasher &hf,
+                                                              const KeyEqual &keyEqual):
+    Map<K,V>::Map(), mTable{nullptr}, mHashFunction(hf), mKeyEqual(keyEqual)
+{
+    mTable.store(new Table(capacityFor(tableSize)), std::memory_order_release);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<class H, class H2, class E>
+ReadMostlyHashTable<K,V,Hasher,KeyEqual>::ReadMostlyHashTable(
+        const OpenAddressingHashTable<K,V,H,H2,E> &source, const Hasher &hf,
+        const KeyEqual &keyEqual):
+    ReadMostlyHashTable(source.count(), hf, keyEqual)
+{
+    auto load = [this](const Array<HashTableItem<K,V>> &data)
+    {
+        for(size_t i{0u}; i < data.size(); ++i)
+        {
+            if(data[i].status == HashTableItemStatus::OCUPIED)
+                insert(data[i].key, data[i].value);
+        }
+    };
+    load(source.mData);
+    load(source.mOldData);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+ReadMostlyHashTable<K,V,Hasher,KeyEqual>::~ReadMostlyHashTable()
+{
+    Table *table = mTable.load(std::memory_order_relaxed);
+    for(size_t i{0u}; i < table->capacity; ++i)
+    {
+        Entry *entry = table->slots[i].load(std::memory_order_relaxed);
+        if(entry && entry != tombstone())
+            delete entry;
+    }
+    delete table;
+    for(size_t i{0u}; i < mRetiredEntries.size(); ++i)
+        delete mRetiredEntries[i];
+    for(size_t i{0u}; i < mRetiredTables.size(); ++i)
+        delete mRetiredTables[i];
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void ReadMostlyHashTable<K,V,Hasher,KeyEqual>::insert(const K &key, const V &value)
+{
+    std::lock_guard<std::mutex> lock(mWriteMutex);
+    publish(new Entry{key, value, fullHash(mHashFunction, key)});
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void ReadMostlyHashTable<K,V,Hasher,KeyEqual>::insert(K &&key, V &&value)
+{
+    auto hash = fullHash(mHashFunction, key);
+    std::lock_guard<std::mutex> lock(mWriteMutex);
+    publish(new Entry{std::move(key), std::move(value), hash});
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void ReadMostlyHashTable<K,V,Hasher,KeyEqual>::update(const K &key, const V &value)
+{
+    std::lock_guard<std::mutex> lock(mWriteMutex);
+    auto hash = fullHash(mHashFunction, key);
+    if(findEntry(mTable.load(std::memory_order_relaxed), key, hash))
+        publish(new Entry{key, value, hash});
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void ReadMostlyHashTable<K,V,Hasher,KeyEqual>::remove(const K &key)
+{
+    std::lock_guard<std::mutex> lock(mWriteMutex);
+    Table *table = mTable.load(std::memory_order_relaxed);
+    bool isFound {false};
+    auto pos = findSlot(table, key, fullHash(mHashFunction, key), isFound);
+    if(!isFound) return;
+    Entry *entry = table->slots[pos].load(std::memory_order_relaxed);
+    table->slots[pos].store(tombstone(), std::memory_order_release);
+    ++mNumberOfDeleted;
+    mSize.fetch_sub(1u, std::memory_order_relaxed);
+    retire(entry);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+bool ReadMostlyHashTable<K,V,Hasher,KeyEqual>::find(const K &key, V &value) const
+{
+    auto hash = fullHash(mHashFunction, key);
+    ReadGuard guard(mEpochs);
+    if(auto entry = findEntry(mTable.load(std::memory_order_acquire), key, hash))
+    {
+        value = entry->value;
+        return true;
+    }
+    return false;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+const V ReadMostlyHashTable<K,V,Hasher,KeyEqual>::get(const K &key) const
+{
+    V val {};
+    find(key, val);
+    return val;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+bool ReadMostlyHashTable<K,V,Hasher,KeyEqual>::contains(const K &key) const
+{
+    auto hash = fullHash(mHashFunction, key);
+    ReadGuard guard(mEpochs);
+    return findEntry(mTable.load(std::memory_order_acquire), key, hash) != nullptr;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void ReadMostlyHashTable<K,V,Hasher,KeyEqual>::clear()
+{
+    std::lock_guard<std::mutex> lock(mWriteMutex);
+    Table *table = mTable.load(std::memory_order_relaxed);
+    mTable.store(new Table(table->capacity), std::memory_order_release);
+    for(size_t i{0u}; i < table->capacity; ++i)
+    {
+        Entry *entry = table->slots[i].load(std::memory_order_relaxed);
+        if(entry && entry != tombstone())
+            mRetiredEntries.add(entry);
+    }
+    mRetiredTables.add(table);
+    mSize.store(0u, std::memory_order_relaxed);
+    mNumberOfDeleted = 0;
+    reclaim();
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void ReadMostlyHashTable<K,V,Hasher,KeyEqual>::reserve(size_t count)
+{
+    std::lock_guard<std::mutex> lock(mWriteMutex);
+    auto newCapacity = capacityFor(count);
+    if(newCapacity > mTable.load(std::memory_order_relaxed)->capacity)
+        rebuild(newCapacity);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void ReadMostlyHashTable<K,V,Hasher,KeyEqual>::setMaxFillFactor(double maxFillFactor)
+{
+    std::lock_guard<std::mutex> lock(mWriteMutex);
+    if(maxFillFactor > 0.0 && maxFillFactor < 1.0)
+        mMaxFillFactor = maxFillFactor;
+}
+
+//Linear probing from the Fibonacci reduction of the hash. Tombstones are
+//skipped, an empty slot ends the search
+template<class K, class V, class Hasher, class KeyEqual>
+auto ReadMostlyHashTable<K,V,Hasher,KeyEqual>::findEntry(const Table *table, const K &key,
+                                                         size_t hash) const -> const Entry*
+{
+    auto mask = table->capacity - 1;
+    auto index = fibonacci_hash(hash, table->capacity);
+    for(size_t numOfProbe{0u}; numOfProbe < table->capacity; ++numOfProbe)
+    {
+        const Entry *entry = table->slots[index].load(std::memory_order_acquire);
+        if(!entry)
+            return nullptr;
+        if(entry != tombstone() && entry->hash == hash && mKeyEqual(entry->key, key))
+            return entry;
+        index = (index + 1) & mask;
+    }
+    return nullptr;
+}
+
+//Writer side lookup: the slot of the key when isFound, otherwise the first
+//free slot of its probe sequence
+template<class K, class V, class Hasher, class KeyEqual>
+size_t ReadMostlyHashTable<K,V,Hasher,KeyEqual>::findSlot(const Table *table, const K &key,
+                                                          size_t hash, bool &isFound) const
+{
+    auto mask = table->capacity - 1;
+    auto index = fibonacci_hash(hash, table->capacity);
+    auto freeIndex = table->capacity;
+    isFound = false;
+    for(size_t numOfProbe{0u}; numOfProbe < table->capacity; ++numOfProbe)
+    {
+        const Entry *entry = table->slots[index].load(std::memory_order_relaxed);
+        if(!entry)
+            return freeIndex < table->capacity ? freeIndex : index;
+        if(entry == tombstone())
+        {
+            if(freeIndex == table->capacity)
+                freeIndex = index;
+        }
+        else if(entry->hash == hash && mKeyEqual(entry->key, key))
+        {
+            isFound = true;
+            return index;
+        }
+        index = (index + 1) & mask;
+    }
+    return freeIndex;
+}
+
+//Puts a new entry in place of the entry of the same key or in a free slot.
+//The entry is fully built before the release store makes it visible
+template<class K, class V, class Hasher, class KeyEqual>
+void ReadMostlyHashTable<K,V,Hasher,KeyEqual>::publish(Entry *entry)
+{
+    Table *table = mTable.load(std::memory_order_relaxed);
+    bool isFound {false};
+    auto pos = findSlot(table, entry->key, entry->hash, isFound);
+    if(isFound)
+    {
+        Entry *oldEntry = table->slots[pos].load(std::memory_order_relaxed);
+        table->slots[pos].store(entry, std::memory_order_release);
+        retire(oldEntry);
+        return;
+    }
+
+    auto size = mSize.load(std::memory_order_relaxed);
+    if(double(size + 1 + mNumberOfDeleted) / table->capacity > mMaxFillFactor)
+    {
+        //Mostly tombstones: a rebuild at the same capacity drops them
+        rebuild(double(size + 1) / table->capacity <= mMaxFillFactor / 2 ?
+                table->capacity : 2 * table->capacity);
+        table = mTable.load(std::memory_order_relaxed);
+        pos = findSlot(table, entry->key, entry->hash, isFound);
+    }
+    if(table->slots[pos].load(std::memory_order_relaxed) == tombstone())
+        --mNumberOfDeleted;
+    table->slots[pos].store(entry, std::memory_order_release);
+    mSize.store(size + 1, std::memory_order_relaxed);
+}
+
+//Builds a new slot array around the same entries, readers keep probing the
+//old one until the new one is published
+template<class K, class V, class Hasher, class KeyEqual>
+void ReadMostlyHashTable<K,V,Hasher,KeyEqual>::rebuild(size_t newCapacity)
+{
+    Table *table = mTable.load(std::memory_order_relaxed);
+    Table *newTable = new Table(newCapacity);
+    auto mask = newCapacity - 1;
+    for(size_t i{0u}; i < table->capacity; ++i)
+    {
+        Entry *entry = table->slots[i].load(std::memory_order_relaxed);
+        if(!entry || entry == tombstone()) continue;
+        auto index = fibonacci_hash(entry->hash, newCapacity);
+        while(newTable->slots[index].load(std::memory_order_relaxed))
+            index = (index + 1) & mask;
+        newTable->slots[index].store(entry, std::memory_order_relaxed);
+    }
+    mTable.store(newTable, std::memory_order_release);
+    mNumberOfDeleted = 0;
+    mRetiredTables.add(table);
+    reclaim();
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+size_t ReadMostlyHashTable<K,V,Hasher,KeyEqual>::capacityFor(size_t count) const
+{
+    return getPowerOfTwoNotLessThan(std::max<size_t>(size_t(std::ceil(count / mMaxFillFactor)) + 1, 2u));
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void ReadMostlyHashTable<K,V,Hasher,KeyEqual>::retire(Entry *entry)
+{
+    mRetiredEntries.add(entry);
+    if(mRetiredEntries.size() >= RECLAIM_THRESHOLD)
+        reclaim();
+}
+
+//Waits until no reader can hold a retired pointer, then frees them all
+template<class K, class V, class Hasher, class KeyEqual>
+void ReadMostlyHashTable<K,V,Hasher,KeyEqual>::reclaim()
+{
+    mEpochs.synchronize();
+    for(size_t i{0u}; i < mRetiredEntries.size(); ++i)
+        delete mRetiredEntries[i];
+    for(size_t i{0u}; i < mRetiredTables.size(); ++i)
+        delete mRetiredTables[i];
+    mRetiredEntries.clear();
+    mRetiredTables.clear();
+}
+
+#endif // READMOSTLY_HASHTABLE_HPP
@@ -0,0 +1,254 @@
+#ifndef SHARDED_MAP_HPP
+#define SHARDED_MAP_HPP
+
+#include <algorithm>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "hashtable.hpp"
+
+//Hasher of the tables inside a ShardedMap. The high bits of the hash picked
+//the shard and are the same for every key of it, so they are shifted out and
+//the table indexes with the remaining, independent bits
+template<class K, class Hasher>
+struct ShardHasher
+{
+    Hasher hasher;
+    unsigned shardBits {0u};
+    inline size_t hash(const K &key) const { return fullHash(hasher, key) << shardBits; }
+    inline size_t operator()(const K &key, size_t max) const { return hash(key) % max; }
+};
+
+//Hash partitioned map for write heavy use from many threads. Keys are spread
+//over independent tables (chained HashTable by default, any table taking
+//(size, hasher) works, e.g. OpenAddressingHashTable), each behind its own
+//mutex and on its own cache lines, so threads updating different shards
+//never touch the same line. The shard is chosen by the high bits of the hash.
+template<class K, class V, class Hasher = DefaultHasher<K>,
+         template<class...> class Table = HashTable>
+class ShardedMap final: public Map<K,V>
+{
+public:
+    using ShardTable = Table<K, V, ShardHasher<K, Hasher>>;
+
+    //shardsNumber is rounded up to a power of two, 0 means two per hardware thread
+    explicit ShardedMap(size_t tableSize, size_t shardsNumber = 0u, const Hasher &hf = Hasher());
+    ShardedMap(const ShardedMap &other) = delete;
+    ShardedMap& operator=(const ShardedMap &rhs) = delete;
+    virtual ~ShardedMap();
+    virtual size_t count() const noexcept override;
+    virtual void insert(const K &key, const V &value) override;
+    virtual void insert(K &&key, V &&value) override;
+    template<class... Args>
+    bool try_emplace(const K &key, Args&&... args);
+    virtual void update(const K &key, const V &value) override;
+    virtual void remove(const K &key) override;
+    virtual bool find(const K &key, V &value) const override;
+    virtual const V get(const K &key) const override;
+    //Calls f(V&) on the value of the key, default-constructed first when the
+    //key is absent, under the lock of its shard. Returns a copy of the result
+    template<class F>
+    V compute(const K &key, F &&f);
+    //Inserts value when the key is absent, otherwise replaces the stored value
+    //with f(stored, value). Returns a copy of the result
+    template<class F>
+    V merge(const K &key, const V &value, F &&f);
+    //Calls f(shardIndex, table) on every shard under its lock. With more than
+    //one thread the shards are split between threads and processed in parallel
+    template<class F>
+    void forEachShard(F &&f, size_t threadsNumber = 1u);
+    template<class F>
+    void forEachShard(F &&f, size_t threadsNumber = 1u) const;
+    void clear();
+    inline size_t shardCount() const noexcept { return mShardsNumber; }
+private:
+    struct alignas(64) Shard
+    {
+        Shard(size_t tableSize, const ShardHasher<K, Hasher> &hf): table(tableSize, hf) {}
+        std::mutex mutex;
+        ShardTable table;
+    };
+
+    Hasher mHashFunction;
+    unsigned mShardBits;
+    size_t mShardsNumber;
+    Shard *mShards {nullptr};
+
+    inline Shard& shardOf(const K &key) const;
+    template<class Self, class F>
+    static void visitShards(Self &self, F &f, size_t threadsNumber);
+};
+
+template<class K, class V, class Hasher, template<class...> class Table>
+ShardedMap<K,V,Hasher,Table>::ShardedMap(size_t tableSize, size_t shardsNumber, const Hasher &hf):
+    Map<K,V>::Map(), mHashFunction(hf)
+{
+    if(shardsNumber == 0)
+        shardsNumber = 2 * std::max(1u, std::thread::hardware_concurrency());
+    mShardsNumber = getPowerOfTwoNotLessThan(shardsNumber);
+    mShardBits = __builtin_ctzll(mShardsNumber);
+    //Shard is not default constructible, so the array is built in raw storage
+    ShardHasher<K, Hasher> shardHasher{hf, mShardBits};
+    auto perShard = tableSize / mShardsNumber + 1;
+    mShards = static_cast<Shard*>(::operator new(mShardsNumber * sizeof(Shard),
+                                                 std::align_val_t{alignof(Shard)}));
+    for(size_t i{0u}; i < mShardsNumber; ++i)
+        new (&mShards[i]) Shard(perShard, shardHasher);
+}
+
+template<class K, class V, class Hasher, template<class...> class Table>
+ShardedMap<K,V,Hasher,Table>::~ShardedMap()
+{
+    for(size_t i{0u}; i < mShardsNumber; ++i)
+        mShards[i].~Shard();
+    ::operator delete(mShards, std::align_val_t{alignof(Shard)});
+}
+
+template<class K, class V, class Hasher, template<class...> class Table>
+size_t ShardedMap<K,V,Hasher,Table>::count() const noexcept
+{
+    size_t total {0u};
+    for(size_t i{0u}; i < mShardsNumber; ++i)
+    {
+        std::lock_guard<std::mutex> lock(mShards[i].mutex);
+        total += mShards[i].table.count();
+    }
+    return total;
+}
+
+template<class K, class V, class Hasher, template<class...> class Table>
+void ShardedMap<K,V,Hasher,Table>::insert(const K &key, const V &value)
+{
+    Shard &shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.table.insert(key, value);
+}
+
+template<class K, class V, class Hasher, template<class...> class Table>
+void ShardedMap<K,V,Hasher,Table>::insert(K &&key, V &&value)
+{
+    Shard &shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.table.insert(std::move(key), std::move(value));
+}
+
+template<class K, class V, class Hasher, template<class...> class Table>
+template<class... Args>
+bool ShardedMap<K,V,Hasher,Table>::try_emplace(const K &key, Args&&... args)
+{
+    Shard &shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.table.try_emplace(key, std::forward<Args>(args)...);
+}
+
+template<class K, class V, class Hasher, template<class...> class Table>
+void ShardedMap<K,V,Hasher,Table>::update(const K &key, const V &value)
+{
+    Shard &shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.table.update(key, value);
+}
+
+template<class K, class V, class Hasher, template<class...> class Table>
+void ShardedMap<K,V,Hasher,Table>::remove(const K &key)
+{
+    Shard &shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.table.remove(key);
+}
+
+template<class K, class V, class Hasher, template<class...> class Table>
+bool ShardedMap<K,V,Hasher,Table>::find(const K &key, V &value) const
+{
+    Shard &shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.table.find(key, value);
+}
+
+template<class K, class V, class Hasher, template<class...> class Table>
+const V ShardedMap<K,V,Hasher,Table>::get(const K &key) const
+{
+    Shard &shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.table.get(key);
+}
+
+template<class K, class V, class Hasher, template<class...> class Table>
+template<class F>
+V ShardedMap<K,V,Hasher,Table>::compute(const K &key, F &&f)
+{
+    Shard &shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    V &value = shard.table[key];
+    f(value);
+    return value;
+}
+
+template<class K, class V, class Hasher, template<class...> class Table>
+template<class F>
+V ShardedMap<K,V,Hasher,Table>::merge(const K &key, const V &value, F &&f)
+{
+    Shard &shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if(shard.table.try_emplace(key, value))
+        return value;
+    V &stored = shard.table[key];
+    stored = f(static_cast<const V&>(stored), value);
+    return stored;
+}
+
+template<class K, class V, class Hasher, template<class...> class Table>
+template<class F>
+void ShardedMap<K,V,Hasher,Table>::forEachShard(F &&f, size_t threadsNumber)
+{
+    visitShards(*this, f, threadsNumber);
+}
+
+template<class K, class V, class Hasher, template<class...> class Table>
+template<class F>
+void ShardedMap<K,V,Hasher,Table>::forEachShard(F &&f, size_t threadsNumber) const
+{
+    visitShards(*this, f, threadsNumber);
+}
+
+template<class K, class V, class Hasher, template<class...> class Table>
+void ShardedMap<K,V,Hasher,Table>::clear()
+{
+    forEachShard([](size_t, ShardTable &table){ table.clear(); });
+}
+
+template<class K, class V, class Hasher, template<class...> class Table>
+inline auto ShardedMap<K,V,Hasher,Table>::shardOf(const K &key) const -> Shard&
+{
+    auto hash = fullHash(mHashFunction, key);
+    return mShards[mShardBits ? hash >> (64 - mShardBits) : 0u];
+}
+
+//Thread t takes the shards t, t + threadsNumber, ... The calling thread
+//works too, so one thread means no thread is started at all
+template<class K, class V, class Hasher, template<class...> class Table>
+template<class Self, class F>
+void ShardedMap<K,V,Hasher,Table>::visitShards(Self &self, F &f, size_t threadsNumber)
+{
+    threadsNumber = std::max<size_t>(1u, std::min(threadsNumber, self.mShardsNumber));
+    using TableRef = std::conditional_t<std::is_const<Self>::value, const ShardTable&, ShardTable&>;
+    auto work = [&self, &f, threadsNumber](size_t first)
+    {
+        for(size_t i{first}; i < self.mShardsNumber; i += threadsNumber)
+        {
+            std::lock_guard<std::mutex> lock(self.mShards[i].mutex);
+            f(i, static_cast<TableRef>(self.mShards[i].table));
+        }
+    };
+    std::vector<std::thread> workers;
+    for(size_t t{1u}; t < threadsNumber; ++t)
+        workers.emplace_back(work, t);
+    work(0u);
+    for(auto &worker : workers)
+        worker.join();
+}
+
+#endif // SHARDED_MAP_HPP
@@ -1,20 +1,32 @@
 #ifndef SINGLY_LINKED_LIST_HPP
 #define SINGLY_LINKED_LIST_HPP
 
+#include <cstdlib>
+#include <new>
+#include <utility>
+
 template<class T>
 class Node
 {
 public:
     explicit Node(const T &mData, Node<T> *next = nullptr);
+    //Builds the data in place from args
+    template<class... Args>
+    explicit Node(Node<T> *next, std::in_place_t, Args&&... args);
     inline Node<T>* next() const noexcept { return mNext; }
     inline const T& data() const noexcept { return mData; }
-    //inline T& data() noexcept { return mData; }
+    inline T& data() noexcept { return mData; }
     inline bool hasNext() const noexcept { return this->mNext; }
     inline void setData(const T &data) { mData = data; }
+    inline void setData(T &&data) { mData = std::move(data); }
     void insertAfter(Node<T> *node);
     void removeAfter();
-    template<class K, class V>
+    template<class K, class V, class Hasher, class KeyEqual>
     friend class HashTable;
+    template<class U>
+    friend class LinkedList;
+    template<class U>
+    friend class NodePool;
 private:
 
     T mData;
@@ -27,6 +39,12 @@ Node<T>::Node(const T &data, Node<T> *next):
     mData{data}, mNext{next}
 {}
 
+template<class T>
+template<class... Args>
+Node<T>::Node(Node<T> *next, std::in_place_t, Args&&... args):
+    mData{std::forward<Args>(args)...}, mNext{next}
+{}
+
 template<class T>
 void Node<T>::insertAfter(Node<T> *node)
 {
@@ -46,13 +64,144 @@ void Node<T>::removeAfter()
     }
 }
 
+//Arena of list nodes. Nodes are carved out of contiguous slabs and the
+//destroyed ones are kept in a free list for reuse, so inserting and removing
+//do not go to the heap. release() gives back every slab at once.
+template<class T>
+class NodePool
+{
+public:
+    explicit NodePool(size_t firstSlabSize = 64u);
+    NodePool(const NodePool<T> &other) = delete;
+    NodePool<T>& operator=(const NodePool<T> &rhs) = delete;
+    ~NodePool();
+    template<class... Args>
+    Node<T>* create(Node<T> *next, Args&&... args);
+    void destroy(Node<T> *node) noexcept;
+    //Carves count nodes out of a dedicated slab and returns them unconstructed,
+    //for the caller to construct in place, possibly from several threads
+    Node<T>* allocateBlock(size_t count);
+    //Takes back the memory of a node that was never constructed
+    void recycle(Node<T> *node) noexcept;
+    //Frees the slabs without destroying the nodes still living there
+    void release() noexcept;
+    inline size_t slabCount() const noexcept { return mSlabCount; }
+private:
+    struct alignas(alignof(Node<T>) > alignof(void*) ? alignof(Node<T>) : alignof(void*)) Slab
+    {
+        Slab *next;
+        size_t capacity;
+    };
+    static constexpr size_t MAX_SLAB_SIZE {65536u};
+    Slab *mSlabs {nullptr};
+    size_t mSlabCount {0u};
+    size_t mUsed {0u};
+    size_t mFirstSlabSize;
+    Node<T> *mFreeList {nullptr};
+    void* allocate();
+};
+
+template<class T>
+NodePool<T>::NodePool(size_t firstSlabSize):
+    mFirstSlabSize{firstSlabSize ? firstSlabSize : 1u}
+{}
+
+template<class T>
+NodePool<T>::~NodePool()
+{
+    release();
+}
+
+template<class T>
+template<class... Args>
+Node<T>* NodePool<T>::create(Node<T> *next, Args&&... args)
+{
+    return new (allocate()) Node<T>(next, std::in_place, std::forward<Args>(args)...);
+}
+
+template<class T>
+void NodePool<T>::destroy(Node<T> *node) noexcept
+{
+    if(!node) return;
+    node->~Node<T>();
+    recycle(node);
+}
+
+template<class T>
+Node<T>* NodePool<T>::allocateBlock(size_t count)
+{
+    if(count == 0) return nullptr;
+    Slab *slab = static_cast<Slab*>(::operator new(sizeof(Slab) + count * sizeof(Node<T>)));
+    slab->capacity = count;
+    //Linked behind the slab being carved, which stays the current one
+    if(mSlabs)
+    {
+        slab->next = mSlabs->next;
+        mSlabs->next = slab;
+    }
+    else
+    {
+        slab->next = nullptr;
+        mSlabs = slab;
+        mUsed = count;
+    }
+    ++mSlabCount;
+    return reinterpret_cast<Node<T>*>(slab + 1);
+}
+
+template<class T>
+void NodePool<T>::recycle(Node<T> *node) noexcept
+{
+    //The dead node's link field chains the free list
+    node->mNext = mFreeList;
+    mFreeList = node;
+}
+
+template<class T>
+void NodePool<T>::release() noexcept
+{
+    while(mSlabs)
+    {
+        Slab *next = mSlabs->next;
+        ::operator delete(mSlabs);
+        mSlabs = next;
+    }
+    mSlabCount = 0;
+    mUsed = 0;
+    mFreeList = nullptr;
+}
+
+template<class T>
+void* NodePool<T>::allocate()
+{
+    if(mFreeList)
+    {
+        Node<T> *node = mFreeList;
+        mFreeList = node->mNext;
+        return node;
+    }
+    if(!mSlabs || mUsed == mSlabs->capacity)
+    {
+        //Every slab is twice as big as the previous one up to MAX_SLAB_SIZE nodes
+        size_t capacity = mSlabs ? mSlabs->capacity * 2 : mFirstSlabSize;
+        if(capacity > MAX_SLAB_SIZE) capacity = MAX_SLAB_SIZE;
+        Slab *slab = static_cast<Slab*>(::operator new(sizeof(Slab) + capacity * sizeof(Node<T>)));
+        slab->next = mSlabs;
+        slab->capacity = capacity;
+        mSlabs = slab;
+        mUsed = 0;
+        ++mSlabCount;
+    }
+    return reinterpret_cast<Node<T>*>(mSlabs + 1) + mUsed++;
+}
+
 template<class T>
 class LinkedList
 {
 public:
     explicit LinkedList();
     LinkedList(const LinkedList<T> &other);
-    LinkedList(LinkedList<T> &&other);
+    LinkedList(LinkedList<T> &&other) noexcept;
     LinkedList<T>& operator=(const LinkedList<T> &rhs);
     LinkedList<T>& operator=(LinkedList<T> &&rhs);
     ~LinkedList();
@@ -60,18 +209,36 @@ public:
     inline int count() const noexcept { return mCount; }
     inline bool isEmpty() const noexcept { return mCount == 0; }
     void pushFront(const T &item);
+    void pushFront(T &&item);
     void insertAt(Node<T> *posToInsert, const T &data);
+    void insertAt(Node<T> *posToInsert, T &&data);
+    template<class... Args>
+    Node<T>* emplaceFront(Args&&... args);
+    template<class... Args>
+    Node<T>* emplaceAt(Node<T> *posToInsert, Args&&... args);
     void pushBack(const T &data);
     void popFront();
     void removeAt(Node<T>* posToRemove);
     void popBack();
     void clear();
     void updateAt(Node<T> *posToUpdate, const T &data);
+    Node<T>* releaseFront() noexcept;
+    void pushFrontNode(Node<T> *node) noexcept;
+    void insertNodeAt(Node<T> *posToInsert, Node<T> *node) noexcept;
     void copyList(const LinkedList<T> &otherList);
     void print();
+    //Nodes are taken from the pool when one is set, from the heap otherwise
+    inline NodePool<T>* pool() const noexcept { return mPool; }
+    inline void setPool(NodePool<T> *pool) noexcept { mPool = pool; }
+    //Forgets the nodes without destroying them, for when their pool is released
+    inline void detachAll() noexcept { mHead = nullptr; mCount = 0; }
 private:
     Node<T> *mHead {nullptr};
     size_t mCount {0u};
+    NodePool<T> *mPool {nullptr};
+    template<class... Args>
+    Node<T>* createNode(Node<T> *next, Args&&... args);
+    void destroyNode(Node<T> *node) noexcept;
 };
 
 template<class T>
@@ -88,10 +255,14 @@ LinkedList<T>::LinkedList(const LinkedList<T> &other)
 }
 
 template<class T>
-LinkedList<T>::LinkedList(LinkedList<T> &&other):
+LinkedList<T>::LinkedList(LinkedList<T> &&other) noexcept:
+    mHead{ other.mHead },
     mCount{ other.mCount },
-    mHead{ std::move(other).mHead }
-{}
+    mPool{ other.mPool }
+{
+    other.mHead = nullptr;
+    other.mCount = 0;
+}
 
 template<class T>
 LinkedList<T>& LinkedList<T>::operator=(const LinkedList<T> &rhs)
@@ -105,9 +276,13 @@ LinkedList<T>& LinkedList<T>::operator=(const LinkedList<T> &rhs)
 template<class T>
 LinkedList<T>& LinkedList<T>::operator=(LinkedList<T> &&rhs)
 {
-    if(this == &rhs) *this;
+    if(this == &rhs) return *this;
+    clear();
     mCount = rhs.mCount;
-    mHead = std::move(rhs).mHead;
+    mHead = rhs.mHead;
+    mPool = rhs.mPool;
+    rhs.mHead = nullptr;
+    rhs.mCount = 0;
     return *this;
 }
 
@@ -121,19 +296,47 @@ LinkedList<T>::~LinkedList()
 template<class T>
 void LinkedList<T>::pushFront(const T &item)
 {
-    Node<T> *node = new Node<T>(item, mHead);
+    emplaceFront(item);
+}
+
+template<class T>
+void LinkedList<T>::pushFront(T &&item)
+{
+    emplaceFront(std::move(item));
+}
+
+template<class T>
+void LinkedList<T>::insertAt(Node<T> *posToInsert, const T &data)
+{
+    emplaceAt(posToInsert, data);
+}
+
+template<class T>
+void LinkedList<T>::insertAt(Node<T> *posToInsert, T &&data)
+{
+    emplaceAt(posToInsert, std::move(data));
+}
+
+template<class T>
+template<class... Args>
+Node<T>* LinkedList<T>::emplaceFront(Args&&... args)
+{
+    Node<T> *node = createNode(mHead, std::forward<Args>(args)...);
     mHead = node;
     ++mCount;
+    return node;
 }
 
 template<class T>
-void LinkedList<T>::insertAt(Node<T> *posToInsert, const T &data)
+template<class... Args>
+Node<T>* LinkedList<T>::emplaceAt(Node<T> *posToInsert, Args&&... args)
 {
-    if(!posToInsert) return;
+    if(!posToInsert) return nullptr;
     Node<T> *nextNext = posToInsert->next();
-    Node<T> *node = new Node<T>(data, nextNext);
+    Node<T> *node = createNode(nextNext, std::forward<Args>(args)...);
     posToInsert->insertAfter(node);
     ++mCount;
+    return node;
 }
 
 template<class T>
@@ -156,7 +359,7 @@ void LinkedList<T>::popFront()
     if(!mHead) return;
     Node<T> *oldHead = mHead;
     mHead = mHead->next();
-    delete oldHead;
+    destroyNode(oldHead);
     --mCount;
 }
 
@@ -172,7 +375,8 @@ void LinkedList<T>::removeAt(Node<T>* posToRemove)
     }
     while(it->next() != posToRemove)
         it = it->next();
-    it->removeAfter();
+    it->mNext = posToRemove->next();
+    destroyNode(posToRemove);
     --mCount;
 }
 
@@ -185,7 +389,6 @@ void LinkedList<T>::popBack()
     if(!it)
     {
         popFront();
-        --mCount;
         return;
     }
     while(it->next())
@@ -193,7 +396,8 @@ void LinkedList<T>::popBack()
         prev = it;
         it = it->next();
     }
-    prev->removeAfter();
+    prev->mNext = nullptr;
+    destroyNode(it);
     --mCount;
 }
 
@@ -210,6 +414,35 @@ void LinkedList<T>::updateAt(Node<T> *posToUpdate, const T &data)
     posToUpdate->setData(data);
 }
 
+//Unlinks the head node without destroying it so it can be relinked elsewhere
+template<class T>
+Node<T>* LinkedList<T>::releaseFront() noexcept
+{
+    if(!mHead) return nullptr;
+    Node<T> *oldHead = mHead;
+    mHead = mHead->next();
+    oldHead->mNext = nullptr;
+    --mCount;
+    return oldHead;
+}
+
+template<class T>
+void LinkedList<T>::pushFrontNode(Node<T> *node) noexcept
+{
+    if(!node) return;
+    node->mNext = mHead;
+    mHead = node;
+    ++mCount;
+}
+
+template<class T>
+void LinkedList<T>::insertNodeAt(Node<T> *posToInsert, Node<T> *node) noexcept
+{
+    if(!posToInsert || !node) return;
+    posToInsert->insertAfter(node);
+    ++mCount;
+}
+
 template<class T>
 void LinkedList<T>::copyList(const LinkedList<T> &otherList)
 {
@@ -220,7 +453,7 @@ void LinkedList<T>::copyList(const LinkedList<T> &otherList)
         while(it->next()) it = it->next();
         while(otherListIterator)
         {
-            Node<T> *node = new Node<T>(otherListIterator->data());
+            Node<T> *node = createNode(nullptr, otherListIterator->data());
             it->insertAfter(node);
             it = it->next();
             otherListIterator = otherListIterator->next();
@@ -237,6 +470,24 @@ void LinkedList<T>::copyList(const LinkedList<T> &otherList)
     }
 }
 
+template<class T>
+template<class... Args>
+Node<T>* LinkedList<T>::createNode(Node<T> *next, Args&&... args)
+{
+    if(mPool)
+        return mPool->create(next, std::forward<Args>(args)...);
+    return new Node<T>(next, std::in_place, std::forward<Args>(args)...);
+}
+
+template<class T>
+void LinkedList<T>::destroyNode(Node<T> *node) noexcept
+{
+    if(mPool)
+        mPool->destroy(node);
+    else
+        delete node;
+}
+
 template<class T>
 void LinkedList<T>::print()
 {
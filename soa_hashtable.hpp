@@ -0,0 +1,480 @@
+#ifndef SOA_HASHTABLE_HPP
+#define SOA_HASHTABLE_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <utility>
+#include <vector>
+#include "hashtable.hpp"
+
+//Open addressing with the slots split into arrays (structure of arrays): one
+//control byte per slot, then the keys, then the values. A probe streams
+//through the control bytes, 64 slots per cache line, and compares a key only
+//when the 7 bits of its hash kept in the control byte match, while the values
+//are only read on a hit. HashTableItem instead drags the value and the padded
+//status of every probed slot through the cache, for std::string keys and
+//double values most of a line per slot.
+//The probing methods are those of OpenAddressingHashTable, on a power of two
+//number of slots (see CapacityMode::POWER_OF_TWO). Resizes are immediate and
+//ROBIN_HOOD keeps its probe distances in a fourth array.
+template<class K, class V, class Hasher = DefaultHasher<K>, class Hasher2 = DefaultStepHasher<K>,
+         class KeyEqual = std::equal_to<K>>
+class SoaOpenAddressingHashTable final: public Map<K,V>
+{
+public:
+    explicit SoaOpenAddressingHashTable(size_t tableSize = 0u, const Hasher &hf = Hasher(),
+                                        CollisionResolutionMethod probingType =
+                                            CollisionResolutionMethod::LINEAR_PROBING,
+                                        const Hasher2 &hf2 = Hasher2(),
+                                        const KeyEqual &keyEqual = KeyEqual());
+    explicit SoaOpenAddressingHashTable(size_t tableSize, CollisionResolutionMethod probingType);
+    virtual void insert(const K &key, const V &value) override;
+    virtual void insert(K &&key, V &&value) override;
+    //Builds the value from args when the key is absent, otherwise leaves the
+    //table and the arguments untouched. Returns true on insertion
+    template<class... Args>
+    bool try_emplace(const K &key, Args&&... args);
+    template<class... Args>
+    bool try_emplace(K &&key, Args&&... args);
+    //Assigns the value of an existing key without touching the key
+    template<class M>
+    bool insert_or_assign(const K &key, M &&value);
+    template<class M>
+    bool insert_or_assign(K &&key, M &&value);
+    virtual void update(const K &key, const V &value) override;
+    void update(const K &key, V &&value);
+    virtual void remove(const K &key) override;
+    virtual bool find(const K &key, V &value) const override;
+    virtual const V get(const K &key) const override;
+    V& operator[](const K &key);
+    const V operator[](const K &key) const;
+    void clear();
+    virtual void print() const;
+    inline size_t capacity() const noexcept { return mControl.size(); }
+    inline double getFillFactor() const noexcept { return double(mCount) / mControl.size(); }
+    inline double maxFillFactor() const noexcept { return mMaxFillFactor; }
+    void setMaxFillFactor(double maxFillFactor);
+    inline size_t tombstoneCount() const noexcept { return mNumberOfDeleted; }
+    inline double maxTombstoneFactor() const noexcept { return mMaxTombstoneFactor; }
+    void setMaxTombstoneFactor(double maxTombstoneFactor);
+    //Same-size rehash in place, dropping every tombstone
+    void compact();
+protected:
+    using Map<K,V>::mCount;
+private:
+    static constexpr uint8_t EMPTY {0x00};
+    static constexpr uint8_t DELETED {0x01};
+
+    std::vector<uint8_t> mControl;      //EMPTY, DELETED or 0x80 | 7 bits of the hash
+    std::vector<K> mKeys;
+    std::vector<V> mValues;
+    std::vector<uint32_t> mDistances;   //Distance from the home slot, ROBIN_HOOD only
+    Hasher mHashFunction;
+    CollisionResolutionMethod mProbingType;
+    Hasher2 mHashFunction2;
+    KeyEqual mKeyEqual;
+    size_t mNumberOfDeleted {0u};
+    double mMaxFillFactor {0.7};
+    double mMaxTombstoneFactor {0.2};
+
+    static inline uint8_t tagOf(size_t hash) noexcept { return uint8_t(0x80 | (hash & 0x7f)); }
+    static inline bool isOccupied(uint8_t control) noexcept { return control & 0x80; }
+    inline bool isRobinHood() const noexcept
+    {
+        return mProbingType == CollisionResolutionMethod::ROBIN_HOOD;
+    }
+    inline size_t probeStep(const K &key) const;
+    inline size_t nextProbe(size_t index, size_t numOfProbe, size_t step) const noexcept;
+    bool has(const K &key, size_t hash, size_t &pos) const;
+    template<class KeyArg, class... Args>
+    std::pair<size_t, bool> tryEmplaceSlot(KeyArg &&key, Args&&... args);
+    size_t place(K &&key, V &&value, size_t hash);
+    size_t placeRobinHood(K &&key, V &&value, size_t hash);
+    void removeRobinHood(size_t pos);
+    void resize(size_t newSize);
+};
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::SoaOpenAddressingHashTable(
+        size_t tableSize, const Hasher &hf, CollisionResolutionMethod probingType,
+        const Hasher2 &hf2, const KeyEqual &keyEqual):
+    Map<K,V>::Map(), mHashFunction{hf}, mProbingType{probingType}, mHashFunction2{hf2},
+    mKeyEqual{keyEqual}
+{
+    resize(getPowerOfTwoNotLessThan(std::max<size_t>(8u, size_t(tableSize / mMaxFillFactor) + 1)));
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::SoaOpenAddressingHashTable(
+        size_t tableSize, CollisionResolutionMethod probingType):
+    SoaOpenAddressingHashTable(tableSize, Hasher(), probingType)
+{}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::insert(const K &key, const V &value)
+{
+    insert_or_assign(key, value);
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::insert(K &&key, V &&value)
+{
+    insert_or_assign(std::move(key), std::move(value));
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+template<class... Args>
+bool SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::try_emplace(const K &key,
+                                                                          Args&&... args)
+{
+    return tryEmplaceSlot(key, std::forward<Args>(args)...).second;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+template<class... Args>
+bool SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::try_emplace(K &&key, Args&&... args)
+{
+    return tryEmplaceSlot(std::move(key), std::forward<Args>(args)...).second;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+template<class M>
+bool SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::insert_or_assign(const K &key,
+                                                                               M &&value)
+{
+    auto [pos, isInserted] = tryEmplaceSlot(key, std::forward<M>(value));
+    if(!isInserted)
+        mValues[pos] = std::forward<M>(value);
+    return isInserted;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+template<class M>
+bool SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::insert_or_assign(K &&key, M &&value)
+{
+    auto [pos, isInserted] = tryEmplaceSlot(std::move(key), std::forward<M>(value));
+    if(!isInserted)
+        mValues[pos] = std::forward<M>(value);
+    return isInserted;
+}
+
+//Returns the slot of the key, creating it from args when the key is absent.
+//The table grows before the item is placed, so the returned slot stays valid
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+template<class KeyArg, class... Args>
+std::pair<size_t, bool> SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::tryEmplaceSlot(
+        KeyArg &&key, Args&&... args)
+{
+    auto hash = fullHash(mHashFunction, key);
+    size_t pos{0};
+    if(has(key, hash, pos))
+        return {pos, false};
+    if(double(mCount + 1 + mNumberOfDeleted) / mControl.size() > mMaxFillFactor)
+    {
+        //Mostly tombstones: reclaiming them is enough, no need to double the memory
+        if(double(mCount + 1) / mControl.size() <= mMaxFillFactor / 2)
+            compact();
+        else
+            resize(2 * mControl.size());
+    }
+    pos = place(K(std::forward<KeyArg>(key)), makeInPlaceValue<V>(std::forward<Args>(args)...),
+                hash);
+    ++mCount;
+    return {pos, true};
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::update(const K &key, const V &value)
+{
+    size_t pos{0};
+    if(has(key, fullHash(mHashFunction, key), pos))
+        mValues[pos] = value;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::update(const K &key, V &&value)
+{
+    size_t pos{0};
+    if(has(key, fullHash(mHashFunction, key), pos))
+        mValues[pos] = std::move(value);
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::remove(const K &key)
+{
+    size_t pos{0};
+    if(!has(key, fullHash(mHashFunction, key), pos))
+        return;
+    --mCount;
+    if(isRobinHood())
+    {
+        removeRobinHood(pos);
+        return;
+    }
+    mControl[pos] = DELETED;
+    ++mNumberOfDeleted;
+    if(mNumberOfDeleted > mMaxTombstoneFactor * mControl.size())
+        compact();
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+bool SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::find(const K &key, V &value) const
+{
+    size_t pos{0};
+    if(!has(key, fullHash(mHashFunction, key), pos))
+        return false;
+    value = mValues[pos];
+    return true;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+const V SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::get(const K &key) const
+{
+    V value {};
+    find(key, value);
+    return value;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+V& SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::operator[](const K &key)
+{
+    return mValues[tryEmplaceSlot(key).first];
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+const V SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::operator[](const K &key) const
+{
+    return get(key);
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::clear()
+{
+    for(auto &control : mControl)
+        control = EMPTY;
+    mCount = 0;
+    mNumberOfDeleted = 0;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::print() const
+{
+    for(size_t i{0u}; i < mControl.size(); ++i)
+    {
+        std::cout << "| " << i << " | ";
+        if(isOccupied(mControl[i]))
+            std::cout << "(" << mKeys[i] << "," << mValues[i] << ")";
+        else
+            std::cout << (mControl[i] == DELETED ? "Deleted" : "Empty");
+        std::cout << " |" << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::setMaxFillFactor(
+        double maxFillFactor)
+{
+    if(maxFillFactor > 0.0 && maxFillFactor < 1.0)
+        mMaxFillFactor = maxFillFactor;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::setMaxTombstoneFactor(
+        double maxTombstoneFactor)
+{
+    if(maxTombstoneFactor > 0.0 && maxTombstoneFactor < 1.0)
+        mMaxTombstoneFactor = maxTombstoneFactor;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+inline size_t SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::probeStep(const K &key) const
+{
+    return probeStepOf(mProbingType, CapacityMode::POWER_OF_TWO, mHashFunction2, key,
+                       mControl.size());
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+inline size_t SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::nextProbe(
+        size_t index, size_t numOfProbe, size_t step) const noexcept
+{
+    return nextProbeIndex(mProbingType, CapacityMode::POWER_OF_TWO, index, numOfProbe, step,
+                          mControl.size());
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+bool SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::has(const K &key, size_t hash,
+                                                                  size_t &pos) const
+{
+    auto tableSize = mControl.size();
+    auto tag = tagOf(hash);
+    auto targetIndex = fibonacci_hash(hash, tableSize);
+    if(isRobinHood())
+    {
+        //A resident closer to home than we are means the key would have been placed before it
+        uint32_t distance {0u};
+        while(isOccupied(mControl[targetIndex]) && mDistances[targetIndex] >= distance)
+        {
+            if(mControl[targetIndex] == tag && mKeyEqual(mKeys[targetIndex], key))
+            {
+                pos = targetIndex;
+                return true;
+            }
+            targetIndex = nextProbe(targetIndex, ++distance, 1);
+        }
+        return false;
+    }
+    auto step = probeStep(key);
+    size_t numOfProbe {0u};
+    while(mControl[targetIndex] != EMPTY)
+    {
+        if(mControl[targetIndex] == tag && mKeyEqual(mKeys[targetIndex], key))
+        {
+            pos = targetIndex;
+            return true;
+        }
+        if(++numOfProbe >= tableSize)
+            break;
+        targetIndex = nextProbe(targetIndex, numOfProbe, step);
+    }
+    return false;
+}
+
+//Moves an item whose key is absent into the first free slot or tombstone of
+//its probe sequence and returns that slot
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+size_t SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::place(K &&key, V &&value,
+                                                                    size_t hash)
+{
+    if(isRobinHood())
+        return placeRobinHood(std::move(key), std::move(value), hash);
+    auto targetIndex = fibonacci_hash(hash, mControl.size());
+    auto step = probeStep(key);
+    size_t numOfProbe {0u};
+    while(isOccupied(mControl[targetIndex]))
+        targetIndex = nextProbe(targetIndex, ++numOfProbe, step);
+    if(mControl[targetIndex] == DELETED)
+        --mNumberOfDeleted;
+    mControl[targetIndex] = tagOf(hash);
+    mKeys[targetIndex] = std::move(key);
+    mValues[targetIndex] = std::move(value);
+    return targetIndex;
+}
+
+//The item that is closer to its home slot gives way, so probe distances stay short.
+//Returns the slot of the inserted item, which is where it first displaced another
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+size_t SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::placeRobinHood(K &&key,
+                                                                             V &&value,
+                                                                             size_t hash)
+{
+    auto tableSize = mControl.size();
+    auto targetIndex = fibonacci_hash(hash, tableSize);
+    auto placedIndex = tableSize;
+    auto tag = tagOf(hash);
+    uint32_t distance {0u};
+    while(isOccupied(mControl[targetIndex]))
+    {
+        if(mDistances[targetIndex] < distance)
+        {
+            std::swap(mControl[targetIndex], tag);
+            std::swap(mKeys[targetIndex], key);
+            std::swap(mValues[targetIndex], value);
+            std::swap(mDistances[targetIndex], distance);
+            if(placedIndex == tableSize)
+                placedIndex = targetIndex;
+        }
+        targetIndex = nextProbe(targetIndex, ++distance, 1);
+    }
+    mControl[targetIndex] = tag;
+    mKeys[targetIndex] = std::move(key);
+    mValues[targetIndex] = std::move(value);
+    mDistances[targetIndex] = distance;
+    return placedIndex == tableSize ? targetIndex : placedIndex;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::removeRobinHood(size_t pos)
+{
+    auto isDisplaced = [this](size_t slot)
+    {
+        return isOccupied(mControl[slot]) && mDistances[slot] > 0;
+    };
+    auto moveBack = [this](size_t from, size_t to)
+    {
+        mControl[to] = mControl[from];
+        mKeys[to] = std::move(mKeys[from]);
+        mValues[to] = std::move(mValues[from]);
+        mDistances[to] = mDistances[from] - 1;
+    };
+    pos = shiftBackward(pos, CapacityMode::POWER_OF_TWO, mControl.size(), isDisplaced, moveBack);
+    mControl[pos] = EMPTY;
+}
+
+//Same algorithm as OpenAddressingHashTable::compact: live items are first
+//marked DELETED meaning "not placed yet", then each one is moved to the first
+//free or not yet placed slot of its probe sequence. ROBIN_HOOD leaves no
+//tombstones
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::compact()
+{
+    if(mNumberOfDeleted == 0 || isRobinHood())
+        return;
+    auto tableSize = mControl.size();
+    for(auto &control : mControl)
+        control = isOccupied(control) ? DELETED : EMPTY;
+    for(size_t i{0u}; i < tableSize; ++i)
+    {
+        while(mControl[i] == DELETED)
+        {
+            auto hash = fullHash(mHashFunction, mKeys[i]);
+            auto targetIndex = fibonacci_hash(hash, tableSize);
+            auto step = probeStep(mKeys[i]);
+            size_t numOfProbe {0u};
+            while(isOccupied(mControl[targetIndex]))
+                targetIndex = nextProbe(targetIndex, ++numOfProbe, step);
+
+            if(targetIndex == i)
+            {
+                mControl[i] = tagOf(hash);
+            }
+            else if(mControl[targetIndex] == EMPTY)
+            {
+                mKeys[targetIndex] = std::move(mKeys[i]);
+                mValues[targetIndex] = std::move(mValues[i]);
+                mControl[targetIndex] = tagOf(hash);
+                mControl[i] = EMPTY;
+            }
+            else
+            {
+                //The target holds an item that is not placed yet, take its slot
+                //and keep going with the evicted item
+                std::swap(mKeys[targetIndex], mKeys[i]);
+                std::swap(mValues[targetIndex], mValues[i]);
+                mControl[targetIndex] = tagOf(hash);
+            }
+        }
+    }
+    mNumberOfDeleted = 0;
+}
+
+template<class K, class V, class Hasher, class Hasher2, class KeyEqual>
+void SoaOpenAddressingHashTable<K,V,Hasher,Hasher2,KeyEqual>::resize(size_t newSize)
+{
+    auto oldControl = std::move(mControl);
+    auto oldKeys = std::move(mKeys);
+    auto oldValues = std::move(mValues);
+    mControl.assign(newSize, EMPTY);
+    mKeys = std::vector<K>(newSize);
+    mValues = std::vector<V>(newSize);
+    mDistances = std::vector<uint32_t>(isRobinHood() ? newSize : 0u);
+    mNumberOfDeleted = 0;
+    for(size_t i{0u}; i < oldControl.size(); ++i)
+    {
+        if(!isOccupied(oldControl[i])) continue;
+        auto hash = fullHash(mHashFunction, oldKeys[i]);
+        place(std::move(oldKeys[i]), std::move(oldValues[i]), hash);
+    }
+}
+
+#endif // SOA_HASHTABLE_HPP
@@ -0,0 +1,522 @@
+#ifndef SWISS_HASHTABLE_HPP
+#define SWISS_HASHTABLE_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <utility>
+#include "hashtable.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+//Open addressing table with the slot metadata kept apart from the slots.
+//Every slot has a control byte: EMPTY, DELETED or the low 7 bits of the hash
+//of the stored key. Probing goes group by group, a group being 16 control
+//bytes compared in one SSE2 instruction, so a lookup reads the key only
+//for the slots whose 7-bit hash fragment already matched.
+
+enum SwissControl : int8_t
+{
+    SWISS_EMPTY = -128,
+    SWISS_DELETED = -2
+};
+
+class SwissGroup
+{
+public:
+    static constexpr size_t WIDTH {16u};
+    explicit SwissGroup(const int8_t *control) noexcept;
+    uint32_t match(int8_t hashFragment) const noexcept;
+    uint32_t matchEmpty() const noexcept;
+    uint32_t matchEmptyOrDeleted() const noexcept;
+private:
+#ifdef __SSE2__
+    __m128i mControl;
+#else
+    int8_t mControl[WIDTH];
+#endif
+};
+
+#ifdef __SSE2__
+
+inline SwissGroup::SwissGroup(const int8_t *control) noexcept:
+    mControl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(control)))
+{}
+
+inline uint32_t SwissGroup::match(int8_t hashFragment) const noexcept
+{
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(hashFragment), mControl));
+}
+
+inline uint32_t SwissGroup::matchEmpty() const noexcept
+{
+    return match(SWISS_EMPTY);
+}
+
+inline uint32_t SwissGroup::matchEmptyOrDeleted() const noexcept
+{
+    //Both special values are negative and below -1, the hash fragments are not
+    return _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), mControl));
+}
+
+#else
+
+inline SwissGroup::SwissGroup(const int8_t *control) noexcept
+{
+    std::memcpy(mControl, control, WIDTH);
+}
+
+inline uint32_t SwissGroup::match(int8_t hashFragment) const noexcept
+{
+    uint32_t mask {0u};
+    for(size_t i{0u}; i < WIDTH; ++i)
+        mask |= uint32_t(mControl[i] == hashFragment) << i;
+    return mask;
+}
+
+inline uint32_t SwissGroup::matchEmpty() const noexcept
+{
+    return match(SWISS_EMPTY);
+}
+
+inline uint32_t SwissGroup::matchEmptyOrDeleted() const noexcept
+{
+    uint32_t mask {0u};
+    for(size_t i{0u}; i < WIDTH; ++i)
+        mask |= uint32_t(mControl[i] < -1) << i;
+    return mask;
+}
+
+#endif
+
+template<class K, class V, class Hasher = DefaultHasher<K>, class KeyEqual = std::equal_to<K>>
+class SwissHashTable final: public Map<K,V>
+{
+public:
+    explicit SwissHashTable(size_t tableSize = 0u, const Hasher &hf = Hasher(),
+                            const KeyEqual &keyEqual = KeyEqual());
+    SwissHashTable(const SwissHashTable &other);
+    SwissHashTable(SwissHashTable &&other) noexcept;
+    SwissHashTable& operator=(const SwissHashTable &rhs);
+    SwissHashTable& operator=(SwissHashTable &&rhs) noexcept;
+    virtual ~SwissHashTable();
+    virtual void insert(const K &key, const V &value) override;
+    virtual void insert(K &&key, V &&value) override;
+    //Builds the value in the slot from args when the key is absent, otherwise
+    //leaves the table and the arguments untouched. Returns true on insertion
+    template<class... Args>
+    bool try_emplace(const K &key, Args&&... args);
+    template<class... Args>
+    bool try_emplace(K &&key, Args&&... args);
+    //Same as try_emplace
+    template<class... Args>
+    bool emplace(const K &key, Args&&... args);
+    template<class... Args>
+    bool emplace(K &&key, Args&&... args);
+    //Assigns the value of an existing key without touching the key
+    template<class M>
+    bool insert_or_assign(const K &key, M &&value);
+    template<class M>
+    bool insert_or_assign(K &&key, M &&value);
+    virtual void update(const K &key, const V &value) override;
+    void update(const K &key, V &&value);
+    virtual void remove(const K &key) override;
+    virtual bool find(const K &key, V &value) const override;
+    virtual const V get(const K &key) const override;
+    V& operator[](const K &key);
+    const V operator[](const K &key) const;
+    void clear();
+    virtual void print() const;
+    inline size_t capacity() const noexcept { return mCapacity; }
+    inline double getFillFactor() const noexcept { return double(mCount) / mCapacity; }
+protected:
+    using Map<K,V>::mCount;
+private:
+    int8_t *mControl {nullptr};
+    Pair<K,V> *mSlots {nullptr};
+    size_t mCapacity {0u};
+    size_t mGrowthLeft {0u};
+    size_t mNumberOfDeleted {0u};
+    Hasher mHashFunction;
+    KeyEqual mKeyEqual;
+
+    static inline size_t maxFilled(size_t capacity) noexcept { return capacity - capacity / 8; }
+    static inline size_t hashOffset(size_t hash) noexcept { return hash >> 7; }
+    static inline int8_t hashFragment(size_t hash) noexcept { return int8_t(hash & 0x7f); }
+    inline size_t groupMask() const noexcept { return mCapacity / SwissGroup::WIDTH - 1; }
+    bool has(const K &key, size_t &pos) const;
+    template<class KeyArg, class... Args>
+    std::pair<size_t, bool> tryEmplaceSlot(KeyArg &&key, Args&&... args);
+    size_t findFreeSlot(size_t hash) const noexcept;
+    size_t prepareInsert(const K &key);
+    void allocate(size_t capacity);
+    void release() noexcept;
+    void resize(size_t newCapacity);
+};
+
+template<class K, class V, class Hasher, class KeyEqual>
+SwissHashTable<K,V,Hasher,KeyEqual>::SwissHashTable(size_t tableSize, const Hasher &hf,
+                                                    const KeyEqual &keyEqual):
+    Map<K,V>::Map(), mHashFunction(hf), mKeyEqual(keyEqual)
+{
+    size_t capacity {SwissGroup::WIDTH};
+    while(maxFilled(capacity) < tableSize)
+        capacity *= 2;
+    allocate(capacity);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+SwissHashTable<K,V,Hasher,KeyEqual>::SwissHashTable(const SwissHashTable &other):
+    Map<K,V>::Map(other), mHashFunction(other.mHashFunction), mKeyEqual(other.mKeyEqual)
+{
+    mCount = 0;
+    allocate(other.mCapacity);
+    for(size_t i{0u}; i < other.mCapacity; ++i)
+    {
+        if(other.mControl[i] >= 0)
+            insert(other.mSlots[i].key, other.mSlots[i].value);
+    }
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+SwissHashTable<K,V,Hasher,KeyEqual>::SwissHashTable(SwissHashTable &&other) noexcept:
+    Map<K,V>::Map(other), mControl(other.mControl), mSlots(other.mSlots),
+    mCapacity(other.mCapacity), mGrowthLeft(other.mGrowthLeft),
+    mNumberOfDeleted(other.mNumberOfDeleted),
+    mHashFunction(std::move(other.mHashFunction)), mKeyEqual(std::move(other.mKeyEqual))
+{
+    other.mControl = nullptr;
+    other.mSlots = nullptr;
+    other.mCapacity = other.mGrowthLeft = other.mNumberOfDeleted = 0;
+    other.mCount = 0;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+SwissHashTable<K,V,Hasher,KeyEqual>& SwissHashTable<K,V,Hasher,KeyEqual>::operator=(
+        const SwissHashTable &rhs)
+{
+    if(this == &rhs) return *this;
+    SwissHashTable copy(rhs);
+    return *this = std::move(copy);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+SwissHashTable<K,V,Hasher,KeyEqual>& SwissHashTable<K,V,Hasher,KeyEqual>::operator=(
+        SwissHashTable &&rhs) noexcept
+{
+    if(this == &rhs) return *this;
+    release();
+    std::swap(mControl, rhs.mControl);
+    std::swap(mSlots, rhs.mSlots);
+    std::swap(mCapacity, rhs.mCapacity);
+    std::swap(mGrowthLeft, rhs.mGrowthLeft);
+    std::swap(mNumberOfDeleted, rhs.mNumberOfDeleted);
+    std::swap(mCount, rhs.mCount);
+    mHashFunction = std::move(rhs.mHashFunction);
+    mKeyEqual = std::move(rhs.mKeyEqual);
+    return *this;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+SwissHashTable<K,V,Hasher,KeyEqual>::~SwissHashTable()
+{
+    release();
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void SwissHashTable<K,V,Hasher,KeyEqual>::insert(const K &key, const V &value)
+{
+    insert_or_assign(key, value);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void SwissHashTable<K,V,Hasher,KeyEqual>::insert(K &&key, V &&value)
+{
+    insert_or_assign(std::move(key), std::move(value));
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<class... Args>
+bool SwissHashTable<K,V,Hasher,KeyEqual>::try_emplace(const K &key, Args&&... args)
+{
+    return tryEmplaceSlot(key, std::forward<Args>(args)...).second;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<class... Args>
+bool SwissHashTable<K,V,Hasher,KeyEqual>::try_emplace(K &&key, Args&&... args)
+{
+    return tryEmplaceSlot(std::move(key), std::forward<Args>(args)...).second;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<class... Args>
+bool SwissHashTable<K,V,Hasher,KeyEqual>::emplace(const K &key, Args&&... args)
+{
+    return tryEmplaceSlot(key, std::forward<Args>(args)...).second;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<class... Args>
+bool SwissHashTable<K,V,Hasher,KeyEqual>::emplace(K &&key, Args&&... args)
+{
+    return tryEmplaceSlot(std::move(key), std::forward<Args>(args)...).second;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<class M>
+bool SwissHashTable<K,V,Hasher,KeyEqual>::insert_or_assign(const K &key, M &&value)
+{
+    auto [pos, isInserted] = tryEmplaceSlot(key, std::forward<M>(value));
+    if(!isInserted)
+        mSlots[pos].value = std::forward<M>(value);
+    return isInserted;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+template<class M>
+bool SwissHashTable<K,V,Hasher,KeyEqual>::insert_or_assign(K &&key, M &&value)
+{
+    auto [pos, isInserted] = tryEmplaceSlot(std::move(key), std::forward<M>(value));
+    if(!isInserted)
+        mSlots[pos].value = std::forward<M>(value);
+    return isInserted;
+}
+
+//Returns the slot of the key, constructing the pair right in the raw slot
+//when the key is absent
+template<class K, class V, class Hasher, class KeyEqual>
+template<class KeyArg, class... Args>
+std::pair<size_t, bool> SwissHashTable<K,V,Hasher,KeyEqual>::tryEmplaceSlot(KeyArg &&key,
+                                                                          Args&&... args)
+{
+    size_t pos{0u};
+    if(has(key, pos))
+        return {pos, false};
+    pos = prepareInsert(key);
+    new (&mSlots[pos]) Pair<K,V>{std::forward<KeyArg>(key),
+                                 makeInPlaceValue<V>(std::forward<Args>(args)...)};
+    return {pos, true};
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void SwissHashTable<K,V,Hasher,KeyEqual>::update(const K &key, const V &value)
+{
+    size_t pos{0u};
+    if(has(key, pos))
+        mSlots[pos].value = value;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void SwissHashTable<K,V,Hasher,KeyEqual>::update(const K &key, V &&value)
+{
+    size_t pos{0u};
+    if(has(key, pos))
+        mSlots[pos].value = std::move(value);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void SwissHashTable<K,V,Hasher,KeyEqual>::remove(const K &key)
+{
+    size_t pos{0u};
+    if(!has(key, pos)) return;
+    mSlots[pos].~Pair<K,V>();
+    --mCount;
+    //A group that still has an empty byte stops every probe passing through it,
+    //so no other key depends on this slot being occupied
+    SwissGroup group(mControl + pos / SwissGroup::WIDTH * SwissGroup::WIDTH);
+    if(group.matchEmpty())
+    {
+        mControl[pos] = SWISS_EMPTY;
+        ++mGrowthLeft;
+    }
+    else
+    {
+        mControl[pos] = SWISS_DELETED;
+        ++mNumberOfDeleted;
+    }
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+bool SwissHashTable<K,V,Hasher,KeyEqual>::find(const K &key, V &value) const
+{
+    size_t pos{0u};
+    if(has(key, pos))
+    {
+        value = mSlots[pos].value;
+        return true;
+    }
+    return false;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+const V SwissHashTable<K,V,Hasher,KeyEqual>::get(const K &key) const
+{
+    size_t pos{0u};
+    return has(key, pos) ? mSlots[pos].value : V();
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+V& SwissHashTable<K,V,Hasher,KeyEqual>::operator[](const K &key)
+{
+    //The slot array may be reallocated, so it is read only after the call
+    auto pos = tryEmplaceSlot(key).first;
+    return mSlots[pos].value;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+const V SwissHashTable<K,V,Hasher,KeyEqual>::operator[](const K &key) const
+{
+    return get(key);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void SwissHashTable<K,V,Hasher,KeyEqual>::clear()
+{
+    for(size_t i{0u}; i < mCapacity; ++i)
+    {
+        if(mControl[i] >= 0)
+            mSlots[i].~Pair<K,V>();
+    }
+    std::memset(mControl, SWISS_EMPTY, mCapacity);
+    mCount = 0;
+    mNumberOfDeleted = 0;
+    mGrowthLeft = maxFilled(mCapacity);
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void SwissHashTable<K,V,Hasher,KeyEqual>::print() const
+{
+    for(size_t i{0u}; i < mCapacity; ++i)
+    {
+        std::cout << "| " << i << " | ";
+        if(mControl[i] >= 0)
+            std::cout << "(" << mSlots[i].key << "," << mSlots[i].value << ")";
+        else if(mControl[i] == SWISS_DELETED)
+            std::cout << "Deleted";
+        else
+            std::cout << "Empty";
+        std::cout << " |" << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+bool SwissHashTable<K,V,Hasher,KeyEqual>::has(const K &key, size_t &pos) const
+{
+    auto hash = fullHash(mHashFunction, key);
+    auto fragment = hashFragment(hash);
+    auto mask = groupMask();
+    auto groupIndex = hashOffset(hash) & mask;
+    for(size_t numOfProbe{1u}; numOfProbe <= mask + 1; ++numOfProbe)
+    {
+        const int8_t *control = mControl + groupIndex * SwissGroup::WIDTH;
+        SwissGroup group(control);
+        for(auto matches = group.match(fragment); matches; matches &= matches - 1)
+        {
+            auto index = groupIndex * SwissGroup::WIDTH + __builtin_ctz(matches);
+            if(mKeyEqual(mSlots[index].key, key))
+            {
+                pos = index;
+                return true;
+            }
+        }
+        if(group.matchEmpty())
+            return false;
+        //Triangular steps visit every group of a power of two table
+        groupIndex = (groupIndex + numOfProbe) & mask;
+    }
+    return false;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+size_t SwissHashTable<K,V,Hasher,KeyEqual>::findFreeSlot(size_t hash) const noexcept
+{
+    auto mask = groupMask();
+    auto groupIndex = hashOffset(hash) & mask;
+    for(size_t numOfProbe{1u};; ++numOfProbe)
+    {
+        SwissGroup group(mControl + groupIndex * SwissGroup::WIDTH);
+        if(auto free = group.matchEmptyOrDeleted())
+            return groupIndex * SwissGroup::WIDTH + __builtin_ctz(free);
+        groupIndex = (groupIndex + numOfProbe) & mask;
+    }
+}
+
+//Claims a slot for a key known to be absent and returns its index
+template<class K, class V, class Hasher, class KeyEqual>
+size_t SwissHashTable<K,V,Hasher,KeyEqual>::prepareInsert(const K &key)
+{
+    auto hash = fullHash(mHashFunction, key);
+    auto pos = findFreeSlot(hash);
+    if(mGrowthLeft == 0 && mControl[pos] != SWISS_DELETED)
+    {
+        //Mostly tombstones: clean them up in place instead of growing
+        if(mCount <= maxFilled(mCapacity) / 2)
+            resize(mCapacity);
+        else
+            resize(mCapacity * 2);
+        pos = findFreeSlot(hash);
+    }
+    if(mControl[pos] == SWISS_DELETED)
+        --mNumberOfDeleted;
+    else
+        --mGrowthLeft;
+    mControl[pos] = hashFragment(hash);
+    ++mCount;
+    return pos;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void SwissHashTable<K,V,Hasher,KeyEqual>::allocate(size_t capacity)
+{
+    mCapacity = capacity;
+    mControl = new int8_t[capacity];
+    std::memset(mControl, SWISS_EMPTY, capacity);
+    mSlots = static_cast<Pair<K,V>*>(::operator new(capacity * sizeof(Pair<K,V>)));
+    mGrowthLeft = maxFilled(capacity);
+    mNumberOfDeleted = 0;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void SwissHashTable<K,V,Hasher,KeyEqual>::release() noexcept
+{
+    if(!mControl) return;
+    for(size_t i{0u}; i < mCapacity; ++i)
+    {
+        if(mControl[i] >= 0)
+            mSlots[i].~Pair<K,V>();
+    }
+    delete [] mControl;
+    ::operator delete(mSlots);
+    mControl = nullptr;
+    mSlots = nullptr;
+    mCapacity = mGrowthLeft = mNumberOfDeleted = 0;
+    mCount = 0;
+}
+
+template<class K, class V, class Hasher, class KeyEqual>
+void SwissHashTable<K,V,Hasher,KeyEqual>::resize(size_t newCapacity)
+{
+    auto oldControl = mControl;
+    auto oldSlots = mSlots;
+    auto oldCapacity = mCapacity;
+    allocate(newCapacity);
+    for(size_t i{0u}; i < oldCapacity; ++i)
+    {
+        if(oldControl[i] < 0) continue;
+        auto hash = fullHash(mHashFunction, oldSlots[i].key);
+        auto pos = findFreeSlot(hash);
+        mControl[pos] = hashFragment(hash);
+        new (&mSlots[pos]) Pair<K,V>(std::move(oldSlots[i]));
+        oldSlots[i].~Pair<K,V>();
+        --mGrowthLeft;
+    }
+    delete [] oldControl;
+    ::operator delete(oldSlots);
+}
+
+#endif // SWISS_HASHTABLE_HPP
@@ -0,0 +1,100 @@
+#ifndef TABLE_STATS_HPP
+#define TABLE_STATS_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+
+//Counters kept on the hot path (collisions, resizes) are compiled in only
+//when HASHTABLE_STATS is 1, which is the default of debug builds. Release
+//builds (NDEBUG) leave them out unless HASHTABLE_STATS is defined as 1.
+#ifndef HASHTABLE_STATS
+#ifdef NDEBUG
+#define HASHTABLE_STATS 0
+#else
+#define HASHTABLE_STATS 1
+#endif
+#endif
+
+//Snapshot returned by stats(). The probe figures and the skew are computed
+//from the current content when stats() is called, the event counters are
+//totals since construction and stay zero when HASHTABLE_STATS is 0.
+struct TableStats
+{
+    static constexpr size_t HISTOGRAM_SIZE {16u};
+    //probeHistogram[i] is the number of items found with i + 1 probes (chained
+    //table: i + 1 nodes walked), the last entry counts all longer ones
+    std::array<size_t, HISTOGRAM_SIZE> probeHistogram {};
+    double averageProbeLength {0.0};
+    size_t maxProbeLength {0u};
+    size_t maxChainLength {0u};         //Chained table only
+    size_t tombstones {0u};             //Open addressing only
+    //Sum of the squared item counts per home slot (bucket) over its expected
+    //value for a uniform hash: 1 is ideal, larger means clustered hashes
+    double skew {0.0};
+    //Placements that met an occupied slot or a non-empty bucket, open
+    //addressing also counts the items moved by a resize
+    size_t collisions {0u};
+    size_t resizes {0u};
+    size_t compactions {0u};
+    double resizeSeconds {0.0};         //Spent in resizes and compactions
+
+    inline void addProbeLength(size_t length) noexcept
+    {
+        ++probeHistogram[length - 1 < HISTOGRAM_SIZE ? length - 1 : HISTOGRAM_SIZE - 1];
+        averageProbeLength += length;
+        maxProbeLength = length > maxProbeLength ? length : maxProbeLength;
+    }
+};
+
+#if HASHTABLE_STATS
+
+class StatsCounters
+{
+public:
+    class Timer
+    {
+    public:
+        explicit Timer(double &seconds): mSeconds(seconds), mStart(std::chrono::steady_clock::now()) {}
+        ~Timer()
+        {
+            mSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - mStart).count();
+        }
+    private:
+        double &mSeconds;
+        std::chrono::steady_clock::time_point mStart;
+    };
+
+    inline void addCollisions(size_t number) noexcept { mCollisions += number; }
+    inline Timer timeResize() noexcept { ++mResizes; return Timer(mResizeSeconds); }
+    inline Timer timeCompaction() noexcept { ++mCompactions; return Timer(mResizeSeconds); }
+    inline void copyTo(TableStats &stats) const noexcept
+    {
+        stats.collisions = mCollisions;
+        stats.resizes = mResizes;
+        stats.compactions = mCompactions;
+        stats.resizeSeconds = mResizeSeconds;
+    }
+private:
+    size_t mCollisions {0u};
+    size_t mResizes {0u};
+    size_t mCompactions {0u};
+    double mResizeSeconds {0.0};
+};
+
+#else
+
+//Same interface doing nothing, the calls vanish once inlined
+class StatsCounters
+{
+public:
+    struct Timer {};
+    inline void addCollisions(size_t) noexcept {}
+    inline Timer timeResize() noexcept { return {}; }
+    inline Timer timeCompaction() noexcept { return {}; }
+    inline void copyTo(TableStats&) const noexcept {}
+};
+
+#endif
+
+#endif // TABLE_STATS_HPP